@@ -0,0 +1,250 @@
+#include "asynchttp.h"
+#include <WiFi.h>
+#include <lwip/pbuf.h>
+
+bool parseHttpUrl(const String& url, String& host, uint16_t& port, String& path) {
+  const char* prefix = "http://";
+  if (!url.startsWith(prefix)) return false;
+  int hostStart = strlen(prefix);
+  int pathStart = url.indexOf('/', hostStart);
+  String authority = pathStart >= 0 ? url.substring(hostStart, pathStart) : url.substring(hostStart);
+  path = pathStart >= 0 ? url.substring(pathStart) : String("/");
+
+  int colon = authority.indexOf(':');
+  if (colon >= 0) {
+    host = authority.substring(0, colon);
+    long p = authority.substring(colon + 1).toInt();
+    if (p < 1 || p > 65535) return false;
+    port = (uint16_t)p;
+  } else {
+    host = authority;
+    port = 80;
+  }
+  return !host.isEmpty();
+}
+
+// ------------------------
+//  Blocking stream over AsyncTCP
+// ------------------------
+AsyncTcpStream::AsyncTcpStream() {
+  _lock = xSemaphoreCreateRecursiveMutex();
+  _connectDone = xSemaphoreCreateBinary();
+  _rx = xQueueCreate(ASYNC_STREAM_RX_SLOTS, sizeof(struct pbuf*));
+}
+
+AsyncTcpStream::~AsyncTcpStream() {
+  stop();
+  vQueueDelete(_rx);
+  vSemaphoreDelete(_connectDone);
+  vSemaphoreDelete(_lock);
+}
+
+// Callbacks from a client that has since been replaced or stopped are ignored;
+// every client deletes itself once AsyncTCP reports it gone
+void AsyncTcpStream::attach(AsyncClient* client) {
+  client->onConnect([](void* arg, AsyncClient* c) {
+    AsyncTcpStream* self = (AsyncTcpStream*)arg;
+    xSemaphoreTakeRecursive(self->_lock, portMAX_DELAY);
+    if (c == self->_tcp) {
+      self->_open = true;
+      xSemaphoreGive(self->_connectDone);
+    }
+    xSemaphoreGiveRecursive(self->_lock);
+  }, this);
+
+  client->onPacket([](void* arg, AsyncClient* c, struct pbuf* pb) {
+    AsyncTcpStream* self = (AsyncTcpStream*)arg;
+    xSemaphoreTakeRecursive(self->_lock, portMAX_DELAY);
+    size_t len = pb->len;
+    if (c != self->_tcp) {
+      pbuf_free(pb);
+    } else if (xQueueSend(self->_rx, &pb, 0) == pdTRUE) {
+      self->_queuedBytes += len;
+    } else {
+      // Cannot happen while the window is smaller than the queue, but never hand
+      // out a stream with a gap in it; the owner sees a dead socket and drops it
+      pbuf_free(pb);
+      self->_overrun = true;
+      self->_open = false;
+    }
+    xSemaphoreGiveRecursive(self->_lock);
+  }, this);
+
+  client->onError([](void* arg, AsyncClient* c, int8_t error) {
+    AsyncTcpStream* self = (AsyncTcpStream*)arg;
+    xSemaphoreTakeRecursive(self->_lock, portMAX_DELAY);
+    if (c == self->_tcp) {
+      self->_open = false;
+      xSemaphoreGive(self->_connectDone);
+    }
+    xSemaphoreGiveRecursive(self->_lock);
+  }, this);
+
+  client->onDisconnect([](void* arg, AsyncClient* c) {
+    AsyncTcpStream* self = (AsyncTcpStream*)arg;
+    xSemaphoreTakeRecursive(self->_lock, portMAX_DELAY);
+    if (c == self->_tcp) {
+      self->_tcp = nullptr;
+      self->_open = false;
+      xSemaphoreGive(self->_connectDone);
+    }
+    xSemaphoreGiveRecursive(self->_lock);
+    delete c;
+  }, this);
+}
+
+int AsyncTcpStream::connect(IPAddress ip, uint16_t port, unsigned long timeoutMs) {
+  stop();
+  AsyncClient* client = new AsyncClient();
+  attach(client);
+
+  xSemaphoreTake(_connectDone, 0);
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  _tcp = client;
+  _overrun = false;
+  bool started = client->connect(ip, port);
+  if (!started && _tcp == client) {
+    // No callback will ever run for it
+    _tcp = nullptr;
+    client->onDisconnect(nullptr);
+    delete client;
+  }
+  xSemaphoreGiveRecursive(_lock);
+  if (!started) return 0;
+
+  xSemaphoreTake(_connectDone, pdMS_TO_TICKS(timeoutMs));
+  if (!_open) {
+    stop();
+    return 0;
+  }
+  return 1;
+}
+
+int AsyncTcpStream::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, getTimeout());
+}
+
+int AsyncTcpStream::connect(const char* host, uint16_t port) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) return 0;
+  return connect(ip, port, getTimeout());
+}
+
+void AsyncTcpStream::stop() {
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  AsyncClient* client = _tcp;
+  _tcp = nullptr;
+  _open = false;
+  // Closing may report the disconnect, and so delete the client, right here
+  if (client) client->close(true);
+  discardPackets();
+  xSemaphoreGiveRecursive(_lock);
+}
+
+void AsyncTcpStream::discardPackets() {
+  if (_packet) pbuf_free(_packet);
+  _packet = nullptr;
+  _offset = 0;
+  struct pbuf* pb;
+  while (xQueueReceive(_rx, &pb, 0) == pdTRUE) pbuf_free(pb);
+  _queuedBytes = 0;
+}
+
+uint8_t AsyncTcpStream::connected() {
+  return !_overrun && (_open || available() > 0);
+}
+
+void AsyncTcpStream::setNoDelay(bool noDelay) {
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  if (_tcp) _tcp->setNoDelay(noDelay);
+  xSemaphoreGiveRecursive(_lock);
+}
+
+void AsyncTcpStream::setKeepAlive(uint32_t idleMs, uint8_t count) {
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  if (_tcp) _tcp->setKeepAlive(idleMs, count);
+  xSemaphoreGiveRecursive(_lock);
+}
+
+// ------------------------
+//  Stream I/O
+// ------------------------
+size_t AsyncTcpStream::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t AsyncTcpStream::write(const uint8_t* buf, size_t size) {
+  size_t written = 0;
+  unsigned long start = millis();
+  while (written < size) {
+    size_t sent = 0;
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    if (!_tcp || !_open) {
+      xSemaphoreGiveRecursive(_lock);
+      break;
+    }
+    size_t space = _tcp->space();
+    if (space > 0) {
+      sent = _tcp->add((const char*)buf + written, min(space, size - written));
+      _tcp->send();
+    }
+    xSemaphoreGiveRecursive(_lock);
+
+    written += sent;
+    if (sent == 0) {
+      if (millis() - start > ASYNC_STREAM_WRITE_TIMEOUT) break;
+      delay(1); // wait for acks to free send buffer
+    }
+  }
+  return written;
+}
+
+// Makes _packet the packet being read, waiting up to `wait` for one to arrive
+bool AsyncTcpStream::nextPacket(TickType_t wait) {
+  if (_packet) return true;
+  if (xQueueReceive(_rx, &_packet, wait) != pdTRUE) return false;
+  _offset = 0;
+  return true;
+}
+
+// Fully read: give the window back to the peer
+void AsyncTcpStream::releasePacket() {
+  struct pbuf* pb = _packet;
+  _packet = nullptr;
+  _offset = 0;
+  _queuedBytes -= pb->len;
+  xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+  if (_tcp) {
+    _tcp->ackPacket(pb);
+  } else {
+    pbuf_free(pb);
+  }
+  xSemaphoreGiveRecursive(_lock);
+}
+
+int AsyncTcpStream::available() {
+  return (int)(_queuedBytes - _offset);
+}
+
+int AsyncTcpStream::peek() {
+  if (!nextPacket(0)) return -1;
+  return ((const uint8_t*)_packet->payload)[_offset];
+}
+
+int AsyncTcpStream::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int AsyncTcpStream::read(uint8_t* buf, size_t size) {
+  size_t total = 0;
+  // Stream::timedRead() polls read(); a one-tick wait keeps that from spinning
+  while (total < size && nextPacket(total == 0 ? 1 : 0)) {
+    size_t n = min((size_t)_packet->len - _offset, size - total);
+    memcpy(buf + total, (const uint8_t*)_packet->payload + _offset, n);
+    _offset += n;
+    total += n;
+    if (_offset >= _packet->len) releasePacket();
+  }
+  return total > 0 ? (int)total : -1;
+}
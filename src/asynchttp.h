@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <AsyncTCP.h>
+#include <atomic>
+
+// Received packets AsyncTcpStream can hold; each is only acknowledged once
+// read, so the TCP window keeps the count well below this
+const int ASYNC_STREAM_RX_SLOTS = 64;
+const unsigned long ASYNC_STREAM_WRITE_TIMEOUT = 5000;
+
+// Parses "http://host[:port]/path"; https is not supported
+bool parseHttpUrl(const String& url, String& host, uint16_t& port, String& path);
+
+// ------------------------
+//  Blocking stream over AsyncTCP
+// ------------------------
+// An Arduino Client for code that reads a response step by step (the Frigate
+// connection and HttpBodyReader). The socket itself lives on the AsyncTCP task:
+// received packets are queued untouched and only acknowledged once the owner
+// has read them, so TCP flow control works as with a plain socket.
+// One owning task; the AsyncTCP callbacks are the only other writers.
+class AsyncTcpStream : public Client {
+public:
+  AsyncTcpStream();
+  ~AsyncTcpStream();
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char* host, uint16_t port) override;
+  int connect(IPAddress ip, uint16_t port, unsigned long timeoutMs);
+
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  // True while the socket is open or unread data remains
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+  void setNoDelay(bool noDelay);
+  // TCP keepalive keeps NAT/conntrack state without sending any HTTP requests
+  void setKeepAlive(uint32_t idleMs, uint8_t count);
+
+private:
+  void attach(AsyncClient* client);
+  bool nextPacket(TickType_t wait);
+  void releasePacket();
+  void discardPackets();
+
+  AsyncClient* _tcp = nullptr;   // guarded by _lock
+  SemaphoreHandle_t _lock;
+  SemaphoreHandle_t _connectDone;
+  QueueHandle_t _rx;             // struct pbuf*
+  std::atomic<size_t> _queuedBytes{0};
+  struct pbuf* _packet = nullptr;
+  size_t _offset = 0;
+  volatile bool _open = false;
+  volatile bool _overrun = false;
+};
@@ -0,0 +1,333 @@
+#include "download.h"
+#include <SD_MMC.h>
+#include <atomic>
+#include "imagecache.h"
+
+static uint8_t downloadBuffer[DOWNLOAD_CHUNK_SIZE];
+static std::atomic<bool> cancelRequested{false};
+
+void cancelDownload() {
+  cancelRequested.store(true);
+}
+
+void resetDownloadCancel() {
+  cancelRequested.store(false);
+}
+
+// ------------------------
+//  HTTP body reader
+// ------------------------
+HttpBodyReader::HttpBodyReader(Client& client, int contentLength, bool chunked, unsigned long timeoutMs)
+  : _client(client), _contentLength(contentLength), _chunked(chunked), _timeoutMs(timeoutMs) {
+  _client.setTimeout(timeoutMs);
+  if (!_chunked && _contentLength == 0) _done = true;
+}
+
+bool HttpBodyReader::waitForData() {
+  unsigned long start = millis();
+  while (!_client.available()) {
+    if (!_client.connected()) return false;
+    if (millis() - start > _timeoutMs) return false;
+    delay(1);
+  }
+  return true;
+}
+
+bool HttpBodyReader::skipLine() {
+  String line = _client.readStringUntil('\n');
+  return line.endsWith("\r");
+}
+
+// Parses "<hex size>[;extensions]\r\n". A zero size ends the body after the trailers.
+bool HttpBodyReader::readChunkHeader() {
+  if (!waitForData()) return false;
+  String line = _client.readStringUntil('\n');
+  line.trim();
+  int semicolon = line.indexOf(';');
+  if (semicolon >= 0) line = line.substring(0, semicolon);
+  if (line.isEmpty()) return false;
+
+  char* end = nullptr;
+  unsigned long size = strtoul(line.c_str(), &end, 16);
+  if (end == line.c_str()) return false;
+
+  if (size == 0) {
+    // Consume optional trailers up to the terminating empty line
+    while (waitForData()) {
+      String trailer = _client.readStringUntil('\n');
+      trailer.trim();
+      if (trailer.isEmpty()) break;
+    }
+    _done = true;
+    return true;
+  }
+  _chunkRemaining = size;
+  return true;
+}
+
+int HttpBodyReader::read(uint8_t* buf, size_t len) {
+  unsigned long start = micros();
+  int n = readBody(buf, len);
+  _readUs += micros() - start;
+  return n;
+}
+
+int HttpBodyReader::readBody(uint8_t* buf, size_t len) {
+  if (_done) return 0;
+  if (_failed) return -1;
+
+  if (_chunked && _chunkRemaining == 0) {
+    if (!readChunkHeader()) {
+      _failed = true;
+      return -1;
+    }
+    if (_done) return 0;
+  }
+
+  size_t want = len;
+  if (_chunked) {
+    want = min(want, _chunkRemaining);
+  } else if (_contentLength > 0) {
+    want = min(want, (size_t)_contentLength - _bytesRead);
+  }
+
+  if (!waitForData()) {
+    // A close is the normal end of a body without length or chunking
+    if (!_chunked && _contentLength < 0 && !_client.connected()) {
+      _done = true;
+      return 0;
+    }
+    _failed = true;
+    return -1;
+  }
+
+  int n = _client.read(buf, want);
+  if (n <= 0) {
+    _failed = true;
+    return -1;
+  }
+  _bytesRead += n;
+
+  if (_chunked) {
+    _chunkRemaining -= n;
+    if (_chunkRemaining == 0 && (!waitForData() || !skipLine())) {
+      _failed = true;
+      return -1;
+    }
+  } else if (_contentLength > 0 && _bytesRead >= (size_t)_contentLength) {
+    _done = true;
+  }
+  return n;
+}
+
+// ------------------------
+//  JPEG integrity check
+// ------------------------
+void JpegIntegrity::update(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (length + i < 2) head[length + i] = data[i];
+    tail[0] = tail[1];
+    tail[1] = data[i];
+  }
+  length += len;
+}
+
+bool JpegIntegrity::complete() const {
+  return length >= 4 &&
+         head[0] == 0xFF && head[1] == 0xD8 &&
+         tail[0] == 0xFF && tail[1] == 0xD9;
+}
+
+// A response body as the tee's upstream; the tee enforces the size limit itself
+class HttpBodySource : public JpegSource {
+public:
+  explicit HttpBodySource(HttpBodyReader& body) : _body(body) {}
+  int read(uint8_t* buf, size_t len) override { return _body.read(buf, len); }
+
+private:
+  HttpBodyReader& _body;
+};
+
+// ------------------------
+//  Stream body to SD
+// ------------------------
+// Every byte pulled from upstream goes to the SD file, the integrity check and
+// the PSRAM cache copy, whether the JPEG decoder or the plain copy loop is pulling.
+class TeeSource : public JpegSource {
+public:
+  TeeSource(JpegSource& upstream, File& file, size_t expected) : _upstream(upstream), _file(file) {
+    if (imageCache.enabled()) {
+      _captureCap = expected > 0 ? expected : 64 * 1024;
+      capture = (uint8_t*)ps_malloc(_captureCap);
+      if (!capture) _captureCap = 0;
+    }
+  }
+  ~TeeSource() { free(capture); }
+
+  // Hands the captured copy over, e.g. to the image cache
+  uint8_t* takeCapture() {
+    uint8_t* data = capture;
+    capture = nullptr;
+    return data;
+  }
+
+  int read(uint8_t* buf, size_t len) override {
+    if (result != DOWNLOAD_OK) return -1;
+    if (cancelRequested.load()) {
+      result = DOWNLOAD_CANCELLED;
+      return -1;
+    }
+    int n = _upstream.read(buf, len);
+    if (n == 0) return 0;
+    if (n < 0) {
+      result = DOWNLOAD_NETWORK_ERROR;
+      return -1;
+    }
+    total += n;
+    if (total > MAX_SNAPSHOT_BYTES) {
+      result = DOWNLOAD_TOO_LARGE;
+      return -1;
+    }
+    jpeg.update(buf, n);
+    if (_file.write(buf, n) != (size_t)n) {
+      result = DOWNLOAD_SD_ERROR;
+      return -1;
+    }
+    appendCapture(buf, n);
+    return n;
+  }
+
+  DownloadResult result = DOWNLOAD_OK;
+  JpegIntegrity jpeg;
+  size_t total = 0;
+  uint8_t* capture = nullptr;
+
+private:
+  // The cache copy is best effort: on allocation failure the image is only on SD
+  void appendCapture(const uint8_t* buf, size_t n) {
+    if (!capture) return;
+    if (total > _captureCap) {
+      size_t cap = max(_captureCap * 2, total);
+      uint8_t* grown = (uint8_t*)heap_caps_realloc(capture, cap, MALLOC_CAP_SPIRAM);
+      if (!grown) {
+        free(capture);
+        capture = nullptr;
+        return;
+      }
+      capture = grown;
+      _captureCap = cap;
+    }
+    memcpy(capture + total - n, buf, n);
+  }
+
+  JpegSource& _upstream;
+  File& _file;
+  size_t _captureCap = 0;
+};
+
+static JpegStreamDecoder teeDecoder;
+
+// Copies the source through a fixed buffer into a temp file, checks the JPEG is
+// complete and only then renames it over the final path.
+static DownloadResult teeJpegToFile(JpegSource& upstream, size_t expected, const String& path, size_t* bytesWritten,
+                                    JpegSink* display, TeeStats* tee) {
+  File file = SD_MMC.open(DOWNLOAD_TEMP_FILE, FILE_WRITE);
+  if (!file) {
+    Serial.println("[DOWNLOAD] Cannot open temp file: " + String(DOWNLOAD_TEMP_FILE));
+    return DOWNLOAD_SD_ERROR;
+  }
+
+  TeeSource source(upstream, file, expected);
+
+  if (display) {
+    if (tee) tee->decodeStartAt = millis();
+    JRESULT decoded = teeDecoder.decode(source, *display);
+    if (tee) {
+      // JDR_INTR means the sink stopped early because the rest was off screen
+      tee->decoded = (decoded == JDR_OK || decoded == JDR_INTR) && teeDecoder.firstBlockAt() != 0;
+      tee->firstPixelAt = teeDecoder.firstBlockAt();
+      tee->lastPixelAt = teeDecoder.lastBlockAt();
+    }
+    if (decoded != JDR_OK && decoded != JDR_INTR) {
+      Serial.printf("[DOWNLOAD] Streaming decode failed (%d), saving only\n", (int)decoded);
+    }
+  }
+
+  // Whatever the decoder did not consume, e.g. trailing bytes after its last MCU
+  while (source.read(downloadBuffer, sizeof(downloadBuffer)) > 0) {
+  }
+  if (tee) tee->lastByteAt = millis();
+  file.close();
+
+  DownloadResult result = source.result;
+  if (result == DOWNLOAD_OK && !source.jpeg.complete()) {
+    result = DOWNLOAD_INCOMPLETE_JPEG;
+  }
+
+  if (result == DOWNLOAD_OK) {
+    if (SD_MMC.exists(path)) SD_MMC.remove(path);
+    if (!SD_MMC.rename(DOWNLOAD_TEMP_FILE, path)) {
+      Serial.println("[DOWNLOAD] Rename failed: " + path);
+      result = DOWNLOAD_SD_ERROR;
+    } else {
+      if (tee) tee->savedAt = millis();
+      if (source.capture) imageCache.adopt(path, source.takeCapture(), source.total);
+    }
+  }
+
+  if (result != DOWNLOAD_OK) {
+    SD_MMC.remove(DOWNLOAD_TEMP_FILE);
+    if (tee) tee->decoded = false;
+  }
+
+  if (bytesWritten) *bytesWritten = source.total;
+  return result;
+}
+
+DownloadResult streamJpegToFile(HttpBodyReader& body, const String& path, size_t* bytesWritten,
+                                JpegSink* display, TeeStats* tee) {
+  HttpBodySource source(body);
+  return teeJpegToFile(source, body.contentLength() > 0 ? body.contentLength() : 0, path, bytesWritten, display, tee);
+}
+
+DownloadResult saveJpegToFile(const uint8_t* data, size_t size, const String& path, size_t* bytesWritten,
+                              JpegSink* display, TeeStats* tee) {
+  if (size > MAX_SNAPSHOT_BYTES) return DOWNLOAD_TOO_LARGE;
+  MemoryJpegSource source(data, size);
+  return teeJpegToFile(source, size, path, bytesWritten, display, tee);
+}
+
+// ------------------------
+//  Stream body to a sink only
+// ------------------------
+class BodySource : public JpegSource {
+public:
+  explicit BodySource(HttpBodyReader& body) : _body(body) {}
+  int read(uint8_t* buf, size_t len) override {
+    if (_body.bytesRead() + len > MAX_SNAPSHOT_BYTES) return -1;
+    return _body.read(buf, len);
+  }
+
+private:
+  HttpBodyReader& _body;
+};
+
+bool streamJpegToSink(HttpBodyReader& body, JpegSink& sink) {
+  BodySource source(body);
+  JRESULT decoded = teeDecoder.decode(source, sink);
+  while (source.read(downloadBuffer, sizeof(downloadBuffer)) > 0) {
+  }
+  return decoded == JDR_OK || decoded == JDR_INTR;
+}
+
+const char* downloadResultToString(DownloadResult result) {
+  switch (result) {
+    case DOWNLOAD_OK: return "ok";
+    case DOWNLOAD_NETWORK_ERROR: return "network error";
+    case DOWNLOAD_TOO_LARGE: return "image too large";
+    case DOWNLOAD_INCOMPLETE_JPEG: return "incomplete JPEG";
+    case DOWNLOAD_SD_ERROR: return "SD write error";
+    case DOWNLOAD_CANCELLED: return "cancelled";
+  }
+  return "unknown";
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include "jpegstream.h"
+
+// Size of the reusable buffer used to copy response bodies to SD
+const size_t DOWNLOAD_CHUNK_SIZE = 2048;
+// Sanity limit for a single snapshot, protects the card from runaway bodies
+const size_t MAX_SNAPSHOT_BYTES = 512 * 1024;
+// Snapshots are written here first and renamed once complete
+const char* const DOWNLOAD_TEMP_FILE = "/events/.download.tmp";
+
+enum DownloadResult {
+  DOWNLOAD_OK,
+  DOWNLOAD_NETWORK_ERROR,
+  DOWNLOAD_TOO_LARGE,
+  DOWNLOAD_INCOMPLETE_JPEG,
+  DOWNLOAD_SD_ERROR,
+  DOWNLOAD_CANCELLED
+};
+
+// ------------------------
+//  HTTP body reader
+// ------------------------
+// Reads a response body from the socket, decoding chunked transfer encoding.
+// A negative contentLength without chunking means "read until the server closes".
+class HttpBodyReader {
+public:
+  HttpBodyReader(Client& client, int contentLength, bool chunked, unsigned long timeoutMs = 10000);
+
+  // Returns bytes copied into buf, 0 at the end of the body, -1 on error or timeout
+  int read(uint8_t* buf, size_t len);
+
+  bool complete() const { return _done; }
+  bool failed() const { return _failed; }
+  size_t bytesRead() const { return _bytesRead; }
+  int contentLength() const { return _contentLength; }
+  // Time spent inside read(): waiting for the network and copying what arrived,
+  // not what the caller does with it (decoding, SD writes)
+  unsigned long readMs() const { return _readUs / 1000; }
+
+private:
+  int readBody(uint8_t* buf, size_t len);
+  bool waitForData();
+  bool readChunkHeader();
+  bool skipLine();
+
+  Client& _client;
+  int _contentLength;
+  bool _chunked;
+  unsigned long _timeoutMs;
+  size_t _bytesRead = 0;
+  size_t _chunkRemaining = 0;
+  bool _done = false;
+  bool _failed = false;
+  unsigned long _readUs = 0;
+};
+
+// ------------------------
+//  JPEG integrity check
+// ------------------------
+// Tracks the SOI/EOI markers of a JPEG as it streams past in arbitrary pieces.
+struct JpegIntegrity {
+  uint8_t head[2] = {0, 0};
+  uint8_t tail[2] = {0, 0};
+  size_t length = 0;
+
+  void update(const uint8_t* data, size_t len);
+  bool complete() const;
+};
+
+// Timing of a download; the decode and pixel fields only when it was decoded
+// to a sink while streaming
+struct TeeStats {
+  bool decoded = false;
+  unsigned long decodeStartAt = 0;
+  unsigned long firstPixelAt = 0;
+  unsigned long lastPixelAt = 0;
+  unsigned long lastByteAt = 0;
+  unsigned long savedAt = 0;
+};
+
+// With a display sink the bytes are decoded to it while they are written to SD
+DownloadResult streamJpegToFile(HttpBodyReader& body, const String& path, size_t* bytesWritten = nullptr,
+                                JpegSink* display = nullptr, TeeStats* tee = nullptr);
+// Same for a JPEG already in memory, e.g. one that arrived over MQTT
+DownloadResult saveJpegToFile(const uint8_t* data, size_t size, const String& path, size_t* bytesWritten = nullptr,
+                              JpegSink* display = nullptr, TeeStats* tee = nullptr);
+// Decodes a body to a sink without saving it, e.g. a preview; drains what the decoder leaves
+bool streamJpegToSink(HttpBodyReader& body, JpegSink& sink);
+const char* downloadResultToString(DownloadResult result);
+
+// Makes the download being streamed give up at its next chunk with
+// DOWNLOAD_CANCELLED, e.g. for a more important event. Any task.
+void cancelDownload();
+void resetDownloadCancel();
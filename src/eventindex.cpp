@@ -0,0 +1,175 @@
+#include "eventindex.h"
+#include <SD_MMC.h>
+#include <algorithm>
+
+EventIndex eventIndex;
+
+// "/events/<id suffix>-<zone>.jpg" -> "<zone>"
+static String zoneFromFilename(const String& name) {
+  int dash = name.indexOf('-', strlen(EVENTS_DIR "/"));
+  int dot = name.lastIndexOf(".jpg");
+  if (dash < 0 || dot <= dash) return "";
+  return name.substring(dash + 1, dot);
+}
+
+// The file's own FAT timestamp, which is all begin() has after a reboot, so an
+// entry's age never depends on whether it was added before or after a restart
+static time_t lastWriteOf(const String& name) {
+  File file = SD_MMC.open(name);
+  if (!file) return 0;
+  time_t mtime = file.getLastWrite();
+  file.close();
+  return mtime;
+}
+
+void EventIndex::begin() {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+
+  std::vector<EventFile> found;
+  File root = SD_MMC.open(EVENTS_DIR);
+  if (root && root.isDirectory()) {
+    File file = root.openNextFile();
+    while (file) {
+      String fname = file.name();
+      if (fname.endsWith(".jpg")) {
+        if (!fname.startsWith("/")) {
+          fname = EVENTS_DIR "/" + fname;
+        }
+        EventFile entry;
+        entry.name = fname;
+        entry.size = file.size();
+        entry.mtime = file.getLastWrite();
+        entry.zone = zoneFromFilename(fname);
+        found.push_back(entry);
+      }
+      file.close();
+      file = root.openNextFile();
+    }
+  }
+  if (root) root.close();
+
+  std::sort(found.begin(), found.end(), [](const EventFile& a, const EventFile& b) {
+    return a.mtime < b.mtime;
+  });
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _files.clear();
+  _byName.clear();
+  _bytes = 0;
+  for (const EventFile& entry : found) {
+    _files.push_back(entry);
+    _byName[entry.name] = std::prev(_files.end());
+    _bytes += entry.size;
+  }
+  xSemaphoreGive(_mutex);
+
+  Serial.printf("[SD_MMC] Indexed %u images (%u KB)\n", (unsigned)found.size(), (unsigned)(_bytes / 1024));
+}
+
+void EventIndex::eraseLocked(std::list<EventFile>::iterator it) {
+  _bytes -= it->size;
+  _byName.erase(it->name);
+  _files.erase(it);
+}
+
+void EventIndex::add(const String& name, size_t size, const String& camera, const String& zone) {
+  if (!_mutex) return;
+  time_t mtime = lastWriteOf(name);
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  auto existing = _byName.find(name);
+  if (existing != _byName.end()) eraseLocked(existing->second);
+
+  EventFile entry;
+  entry.name = name;
+  entry.size = size;
+  entry.mtime = mtime;
+  entry.camera = camera;
+  entry.zone = zone;
+  _files.push_back(entry);
+  _byName[name] = std::prev(_files.end());
+  _bytes += size;
+  xSemaphoreGive(_mutex);
+}
+
+void EventIndex::setValidators(const String& name, const String& etag, const String& lastModified) {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  auto it = _byName.find(name);
+  if (it != _byName.end()) {
+    it->second->etag = etag;
+    it->second->lastModified = lastModified;
+  }
+  xSemaphoreGive(_mutex);
+}
+
+bool EventIndex::validators(const String& name, String& etag, String& lastModified) {
+  if (!_mutex) return false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  auto it = _byName.find(name);
+  bool found = it != _byName.end();
+  if (found) {
+    etag = it->second->etag;
+    lastModified = it->second->lastModified;
+  }
+  xSemaphoreGive(_mutex);
+  return found;
+}
+
+void EventIndex::remove(const String& name) {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  auto it = _byName.find(name);
+  if (it != _byName.end()) eraseLocked(it->second);
+  xSemaphoreGive(_mutex);
+}
+
+void EventIndex::clear() {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _files.clear();
+  _byName.clear();
+  _bytes = 0;
+  xSemaphoreGive(_mutex);
+}
+
+bool EventIndex::contains(const String& name) {
+  if (!_mutex) return false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool found = _byName.count(name) > 0;
+  xSemaphoreGive(_mutex);
+  return found;
+}
+
+bool EventIndex::oldest(EventFile& out) {
+  if (!_mutex) return false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool found = !_files.empty();
+  if (found) out = _files.front();
+  xSemaphoreGive(_mutex);
+  return found;
+}
+
+size_t EventIndex::count() {
+  if (!_mutex) return 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  size_t n = _files.size();
+  xSemaphoreGive(_mutex);
+  return n;
+}
+
+size_t EventIndex::totalBytes() {
+  if (!_mutex) return 0;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  size_t bytes = _bytes;
+  xSemaphoreGive(_mutex);
+  return bytes;
+}
+
+std::vector<EventFile> EventIndex::snapshot() {
+  std::vector<EventFile> copy;
+  if (!_mutex) return copy;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  copy.assign(_files.begin(), _files.end());
+  xSemaphoreGive(_mutex);
+  return copy;
+}
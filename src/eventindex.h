@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+#include <list>
+#include <map>
+#include <vector>
+
+#define EVENTS_DIR "/events"
+
+struct EventFile {
+  String name;            // full path, e.g. "/events/abc123-front.jpg"
+  size_t size = 0;
+  time_t mtime = 0;       // FAT last write, 0 when unknown
+  String camera;          // empty for files found at boot, the filename does not carry it
+  String zone;
+  String etag;            // HTTP validators of the download, for conditional refresh
+  String lastModified;
+};
+
+// ------------------------
+//  In-memory index of /events
+// ------------------------
+// Built from one directory scan at boot and kept current on every add and
+// delete, so eviction, the gallery and the slideshow never walk the SD card.
+// Entries are ordered oldest first. Thread safe.
+class EventIndex {
+public:
+  void begin();
+
+  // Adds or refreshes an entry as the newest file; name must already be on the card
+  void add(const String& name, size_t size, const String& camera, const String& zone);
+  void remove(const String& name);
+  void clear();
+
+  bool contains(const String& name);
+  void setValidators(const String& name, const String& etag, const String& lastModified);
+  // False when the file is not in the index; empty strings when the server sent none
+  bool validators(const String& name, String& etag, String& lastModified);
+  // Oldest entry in O(1); false when the index is empty
+  bool oldest(EventFile& out);
+  size_t count();
+  size_t totalBytes();
+  // Copy of all entries, oldest first
+  std::vector<EventFile> snapshot();
+
+private:
+  void eraseLocked(std::list<EventFile>::iterator it);
+
+  std::list<EventFile> _files;
+  std::map<String, std::list<EventFile>::iterator> _byName;
+  size_t _bytes = 0;
+  SemaphoreHandle_t _mutex = nullptr;
+};
+
+extern EventIndex eventIndex;
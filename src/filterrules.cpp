@@ -0,0 +1,233 @@
+#include "filterrules.h"
+
+FilterRules filterRules;
+
+// Set for values that no rule names: only matches fields a rule left open
+static const uint32_t OTHER_BIT = 1UL << FILTER_MAX_NAMES;
+static const uint32_t ANY_MASK = 0xFFFFFFFFUL;
+
+static const char* const FIELD_KEYS[FILTER_FIELDS] = {"severity", "camera", "label", "zone"};
+
+// FNV-1a, case-insensitive so "Front_Door" in a rule matches "front_door" from Frigate
+uint32_t FilterRules::hashName(const char* s, size_t len) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)tolower((unsigned char)s[i]);
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+// Two names can share a hash, so a hit is only a match if the text agrees too
+bool FilterRules::sameName(const Name& n, uint32_t hash, const char* s, size_t len) {
+  if (n.hash != hash || n.lower.length() != len) return false;
+  const char* lower = n.lower.c_str();
+  for (size_t i = 0; i < len; i++) {
+    if (tolower((unsigned char)s[i]) != lower[i]) return false;
+  }
+  return true;
+}
+
+int FilterRules::intern(FilterField field, const String& name) {
+  uint32_t h = hashName(name.c_str(), name.length());
+  std::vector<Name>& names = _names[field];
+  for (const Name& n : names) {
+    if (sameName(n, h, name.c_str(), name.length())) return n.bit;
+  }
+  if (names.size() >= (size_t)FILTER_MAX_NAMES) return -1;
+  String lower = name;
+  lower.toLowerCase();
+  names.push_back({h, lower, (uint8_t)names.size()});
+  return names.back().bit;
+}
+
+uint32_t FilterRules::bitOf(FilterField field, const char* s, size_t len) const {
+  uint32_t h = hashName(s, len);
+  for (const Name& n : _names[field]) {
+    if (sameName(n, h, s, len)) return 1UL << n.bit;
+  }
+  return OTHER_BIT;
+}
+
+// Any of the values may match; labels drop Frigate's "-verified" style suffixes
+uint32_t FilterRules::bitsOf(FilterField field, JsonArray values, bool stripSuffix) const {
+  uint32_t bits = 0;
+  for (JsonVariant v : values) {
+    const char* s = v.as<const char*>();
+    if (!s) continue;
+    size_t len = strlen(s);
+    if (stripSuffix) {
+      const char* dash = strchr(s, '-');
+      if (dash && dash > s) len = dash - s;
+    }
+    bits |= bitOf(field, s, len);
+  }
+  return bits ? bits : OTHER_BIT;
+}
+
+bool FilterRules::parseLine(const String& line, Rule& rule) {
+  rule.show = true;
+  rule.durationSec = 0;
+  rule.priority = 0;
+  for (int f = 0; f < FILTER_FIELDS; f++) rule.masks[f] = ANY_MASK;
+
+  int pos = 0;
+  bool first = true;
+  while (pos < (int)line.length()) {
+    int space = line.indexOf(' ', pos);
+    if (space < 0) space = line.length();
+    String token = line.substring(pos, space);
+    pos = space + 1;
+    if (token.isEmpty()) continue;
+
+    if (first) {
+      first = false;
+      if (token == "show") continue;
+      if (token == "ignore") {
+        rule.show = false;
+        continue;
+      }
+      return false;
+    }
+
+    int eq = token.indexOf('=');
+    if (eq <= 0) return false;
+    String key = token.substring(0, eq);
+    String value = token.substring(eq + 1);
+    if (key == "duration") {
+      rule.durationSec = constrain(value.toInt(), 0, 3600);
+      continue;
+    }
+    if (key == "priority") {
+      rule.priority = constrain(value.toInt(), 0, 255);
+      continue;
+    }
+
+    int field = -1;
+    for (int f = 0; f < FILTER_FIELDS; f++) {
+      if (key == FIELD_KEYS[f]) field = f;
+    }
+    if (field < 0) return false;
+
+    uint32_t mask = 0;
+    int start = 0;
+    while (start <= (int)value.length()) {
+      int comma = value.indexOf(',', start);
+      if (comma < 0) comma = value.length();
+      String name = value.substring(start, comma);
+      start = comma + 1;
+      if (name.isEmpty()) continue;
+      int bit = intern((FilterField)field, name);
+      if (bit < 0) return false;
+      mask |= 1UL << bit;
+    }
+    if (mask == 0) return false;
+    rule.masks[field] = mask;
+  }
+  return !first;
+}
+
+int FilterRules::compile(const String& text) {
+  // Build into locals, then swap in, so match() never sees half a rule set
+  FilterRules compiled;
+  int lineNo = 0;
+  int start = 0;
+  while (start < (int)text.length()) {
+    int nl = text.indexOf('\n', start);
+    if (nl < 0) nl = text.length();
+    String line = text.substring(start, nl);
+    start = nl + 1;
+    lineNo++;
+    line.trim();
+    line.replace('\t', ' ');
+    if (line.isEmpty() || line.startsWith("#")) continue;
+    if (compiled._ruleCount >= FILTER_MAX_RULES) {
+      Serial.printf("[FILTER] More than %d rules, ignoring line %d\n", FILTER_MAX_RULES, lineNo);
+      continue;
+    }
+    Rule rule;
+    if (compiled.parseLine(line, rule)) {
+      compiled._rules[compiled._ruleCount++] = rule;
+    } else {
+      Serial.printf("[FILTER] Ignoring line %d: %s\n", lineNo, line.c_str());
+    }
+  }
+
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  memcpy(_rules, compiled._rules, sizeof(_rules));
+  _ruleCount = compiled._ruleCount;
+  for (int f = 0; f < FILTER_FIELDS; f++) _names[f].swap(compiled._names[f]);
+  _stats.rules = _ruleCount;
+  xSemaphoreGive(_mutex);
+
+  Serial.printf("[FILTER] %d rules compiled\n", _ruleCount);
+  return _ruleCount;
+}
+
+String FilterRules::fromMode(const String& mode) {
+  String m = mode;
+  m.toLowerCase();
+  String rules;
+  if (m.indexOf("alert") >= 0) rules += "show severity=alert\n";
+  if (m.indexOf("detection") >= 0) rules += "show severity=detection\n";
+  return rules;
+}
+
+int FilterRules::firstMatchLocked(const uint32_t bits[FILTER_FIELDS]) const {
+  for (int r = 0; r < _ruleCount; r++) {
+    const Rule& rule = _rules[r];
+    if ((rule.masks[FIELD_SEVERITY] & bits[FIELD_SEVERITY]) && (rule.masks[FIELD_CAMERA] & bits[FIELD_CAMERA]) &&
+        (rule.masks[FIELD_LABEL] & bits[FIELD_LABEL]) && (rule.masks[FIELD_ZONE] & bits[FIELD_ZONE])) {
+      return r;
+    }
+  }
+  return -1;
+}
+
+FilterDecision FilterRules::match(JsonObject msg) {
+  return match(msg["severity"] | "", msg["camera"] | "", msg["data"]["objects"].as<JsonArray>(),
+               msg["data"]["zones"].as<JsonArray>());
+}
+
+FilterDecision FilterRules::match(const char* severity, const char* camera, JsonArray labels, JsonArray zones) {
+  FilterDecision decision;
+  if (!_mutex) return decision;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  uint32_t bits[FILTER_FIELDS];
+  bits[FIELD_SEVERITY] = bitOf(FIELD_SEVERITY, severity, strlen(severity));
+  bits[FIELD_CAMERA] = bitOf(FIELD_CAMERA, camera, strlen(camera));
+  bits[FIELD_LABEL] = bitsOf(FIELD_LABEL, labels, true);
+  bits[FIELD_ZONE] = bitsOf(FIELD_ZONE, zones, false);
+
+  int r = firstMatchLocked(bits);
+  if (r >= 0) {
+    decision.show = _rules[r].show;
+    decision.durationSec = _rules[r].durationSec;
+    decision.priority = _rules[r].priority;
+    decision.rule = r;
+  }
+  _stats.evaluated++;
+  if (decision.rule < 0) _stats.unmatched++;
+  else if (decision.show) _stats.shown++;
+  else _stats.ignored++;
+  xSemaphoreGive(_mutex);
+  return decision;
+}
+
+bool FilterRules::mayShow(const char* camera, JsonArray labels, JsonArray zones) {
+  if (!_mutex) return false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  uint32_t bits[FILTER_FIELDS];
+  bits[FIELD_CAMERA] = bitOf(FIELD_CAMERA, camera, strlen(camera));
+  bits[FIELD_LABEL] = bitsOf(FIELD_LABEL, labels, true);
+  bits[FIELD_ZONE] = bitsOf(FIELD_ZONE, zones, false);
+  bool show = false;
+  for (const char* severity : {"alert", "detection"}) {
+    bits[FIELD_SEVERITY] = bitOf(FIELD_SEVERITY, severity, strlen(severity));
+    int r = firstMatchLocked(bits);
+    if (r >= 0 && _rules[r].show) show = true;
+  }
+  xSemaphoreGive(_mutex);
+  return show;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+// Rules kept after compiling; later lines are ignored
+const int FILTER_MAX_RULES = 16;
+// Distinct names per field a rule set may mention; each one is a bit in a mask
+const int FILTER_MAX_NAMES = 31;
+
+enum FilterField {
+  FIELD_SEVERITY,
+  FIELD_CAMERA,
+  FIELD_LABEL,
+  FIELD_ZONE,
+  FILTER_FIELDS
+};
+
+// What the first matching rule says about a review
+struct FilterDecision {
+  bool show = false;
+  uint16_t durationSec = 0;   // 0 = the configured display duration
+  uint8_t priority = 0;       // higher goes first
+  int rule = -1;              // index of the matching rule, -1 when none matched
+};
+
+struct FilterStats {
+  uint32_t evaluated = 0;
+  uint32_t shown = 0;
+  uint32_t ignored = 0;
+  uint32_t unmatched = 0;
+  size_t rules = 0;
+};
+
+// ------------------------
+//  Compiled filter rules
+// ------------------------
+// One rule per line, the first that matches decides:
+//
+//   show severity=alert camera=front_door
+//   show severity=detection label=person zone=driveway duration=20 priority=2
+//   ignore label=cat
+//
+// A field left out matches anything; "a,b" matches either. compile() interns
+// every name into a small per-field ID and turns each rule into one bitmask per
+// field, so matching a review hashes each of its values once, confirms the name
+// on a hash hit and ANDs masks, without allocating. A review no rule matches is
+// not shown. Compiled from the web server or setup(), matched on the MQTT task;
+// a mutex guards the swap.
+class FilterRules {
+public:
+  // Replaces the rule set. Bad lines are skipped; returns how many rules compiled.
+  int compile(const String& text);
+  // The old "alert,detection" mode setting as rules
+  static String fromMode(const String& mode);
+
+  // msg is a review's "before" or "after" object. Shows nothing before the first compile().
+  FilterDecision match(JsonObject msg);
+  // Same, for callers that already extracted the fields
+  FilterDecision match(const char* severity, const char* camera, JsonArray labels, JsonArray zones);
+  // Whether a review of the object could be shown, whatever its severity turns
+  // out to be. For prefetching from frigate/events; not counted in stats().
+  bool mayShow(const char* camera, JsonArray labels, JsonArray zones);
+
+  const FilterStats& stats() const { return _stats; }
+
+private:
+  struct Rule {
+    bool show;
+    uint32_t masks[FILTER_FIELDS];
+    uint16_t durationSec;
+    uint8_t priority;
+  };
+  struct Name {
+    uint32_t hash;
+    String lower;  // the name lower-cased, compared when hashes are equal
+    uint8_t bit;
+  };
+
+  static uint32_t hashName(const char* s, size_t len);
+  static bool sameName(const Name& n, uint32_t hash, const char* s, size_t len);
+  int intern(FilterField field, const String& name);
+  uint32_t bitOf(FilterField field, const char* s, size_t len) const;
+  uint32_t bitsOf(FilterField field, JsonArray values, bool stripSuffix) const;
+  bool parseLine(const String& line, Rule& rule);
+  // Index of the first rule matching all fields, -1 when none; mutex held
+  int firstMatchLocked(const uint32_t bits[FILTER_FIELDS]) const;
+
+  Rule _rules[FILTER_MAX_RULES];
+  int _ruleCount = 0;
+  std::vector<Name> _names[FILTER_FIELDS];
+  SemaphoreHandle_t _mutex = nullptr;
+  FilterStats _stats;
+};
+
+extern FilterRules filterRules;
@@ -1,183 +1,934 @@
 #include "frigate.h"
-#include <HTTPClient.h>
 #include <SD_MMC.h>
+#include <ArduinoJson.h>
 #include "main.h" // For setScreen, tft, etc.
+#include "download.h"
+#include "filterrules.h"
+#include "frigateconn.h"
+#include "eventindex.h"
+#include "imagecache.h"
+#include "jobqueue.h"
+#include "prefetch.h"
+#include "quality.h"
+#include "retention.h"
 
 String frigateIP = "";
 int frigatePort = 5000;
 unsigned long lastFrigateRequest = 0;
 std::vector<String> jpgQueue;
-bool imagePending = false;
-String pendingImageUrl = "";
-String pendingZone = "";
+std::vector<String> galleryQueue;
+DisplayLatencyStats displayLatency;
+CircuitBreaker frigateBreaker(FRIGATE_BREAKER_THRESHOLD, FRIGATE_PROBE_MIN_DELAY, FRIGATE_PROBE_MAX_DELAY);
+FrigateRetryStats frigateRetryStats;
+BackfillStats backfillStats;
+RefreshStats refreshStats;
 
+static QueueHandle_t downloadResults = nullptr;
+static TaskHandle_t downloadTask = nullptr;
 
-// ------------------------
-//  Display image from API
-// ------------------------
-void displayImageFromAPI(String url, String zone) {
-  const int maxTries = 5;
-  int tries = 0;
-  bool success = false;
-  const size_t MAX_FILE_SIZE = 40 * 1024;
+static void postResult(const DownloadJob& job, const String& filename, bool success, const char* error, bool drawn = false) {
+  if (job.speculative) return; // nothing to show until its review asks for it
+  if ((job.backfill || job.refresh) && !success) return; // nothing was announced, or the old snapshot is still fine
+  DownloadResultMsg msg = {};
+  strlcpy(msg.filename, filename.c_str(), sizeof(msg.filename));
+  msg.success = success;
+  msg.drawn = drawn;
+  msg.refreshed = job.refresh;
+  msg.gallery = job.backfill;
+  msg.displaySec = job.displaySec;
+  msg.queuedAt = job.queuedAt;
+  strlcpy(msg.error, error, sizeof(msg.error));
+  msg.trace = job.trace;
+  if (xQueueSend(downloadResults, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    Serial.println("[FRIGATE] Result queue full, dropped: " + filename);
+  }
+}
+
+// Tells loop() the event screen is up with a preview on it
+static void postPreview(const DownloadJob& job) {
+  DownloadResultMsg msg = {};
+  msg.preview = true;
+  msg.displaySec = job.displaySec;
+  msg.queuedAt = job.queuedAt;
+  if (xQueueSend(downloadResults, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
+    Serial.println("[FRIGATE] Result queue full, dropped preview");
+  }
+}
 
-  // Construct detectionId from URL
+static void showImageError(const char* message) {
+  setScreen("error", 10, "handleDownloadResults");
+  tft.setCursor(10, 30);
+  tft.setTextColor(TFT_RED);
+  tft.setTextSize(2);
+  tft.println(message);
+}
+
+// <suffix>-<zone>.jpg, derived from the event id in the snapshot URL
+static String snapshotFilename(const String& url, const String& zone) {
   String detectionId = url.substring(url.lastIndexOf("/events/") + 8, url.indexOf("/snapshot.jpg"));
   int dashIndex = detectionId.indexOf("-");
   String suffix = (dashIndex > 0) ? detectionId.substring(dashIndex + 1) : detectionId;
 
-  // New filename: <suffix>-<zone>.jpg
   String filename = "/events/" + suffix + "-" + zone + ".jpg";
   if (filename.length() >= 32) {
     filename = "/events/default.jpg";
   }
+  return filename;
+}
 
-  // Skip if image already exists
-  if (SD_MMC.exists(filename)) {
-    Serial.print("[DEBUG] Image already exists: "); Serial.println(filename);
-    if (std::find(jpgQueue.begin(), jpgQueue.end(), filename) == jpgQueue.end()) {
-      jpgQueue.push_back(filename);
+// Same event, small thumbnail instead of the snapshot
+static String thumbnailUrl(const String& snapshotUrl) {
+  int snapshot = snapshotUrl.indexOf("/snapshot.jpg");
+  if (snapshot < 0) return "";
+  return snapshotUrl.substring(0, snapshot) + "/thumbnail.jpg";
+}
+
+String frigateSnapshotUrl(const String& eventId) {
+  return "http://" + frigateIP + ":" + String(frigatePort) +
+         "/api/events/" + eventId + "/snapshot.jpg?crop=1&height=240";
+}
+
+// Copies the stage times of a finished download into the job's latency trace
+static void traceDownload(DownloadJob& job, const FrigateResponse& resp, const TeeStats& tee) {
+  if (!job.trace.active()) return;
+  EventTrace& trace = job.trace;
+  trace.stamp(STAGE_CONNECT, resp.connectedAt);
+  trace.stamp(STAGE_FIRST_BYTE, resp.firstByteAt);
+  trace.stamp(STAGE_LAST_BYTE, tee.lastByteAt);
+  trace.stamp(STAGE_SAVED, tee.savedAt);
+  if (tee.decoded) {
+    trace.stamp(STAGE_DECODE_START, tee.decodeStartAt);
+    trace.stamp(STAGE_LAST_MCU, tee.lastPixelAt);
+    trace.tee = true;
+  }
+  trace.attempts = job.attempts + 1;
+}
+
+static void recordTeeLatency(const DownloadJob& job, const TeeStats& tee) {
+  if (!tee.decoded) return;
+  displayLatency.teeEvents++;
+  displayLatency.teeFirstPixelMs = tee.firstPixelAt - job.queuedAt;
+  displayLatency.teeFullFrameMs = tee.lastPixelAt - job.queuedAt;
+  displayLatency.teeFirstPixelTotalMs += displayLatency.teeFirstPixelMs;
+  displayLatency.teeFullFrameTotalMs += displayLatency.teeFullFrameMs;
+  Serial.printf("[TEE] Event-to-pixel: first %lu ms, full frame %lu ms, saved %lu ms\n",
+                displayLatency.teeFirstPixelMs, displayLatency.teeFullFrameMs, millis() - job.queuedAt);
+}
+
+// Streams a 200 response body to SD, releases the connection and posts the
+// result on success. Jobs marked for display are decoded to the panel on the way.
+// quality is what was asked of Frigate, -1 if the URL chose its own.
+static DownloadResult receiveSnapshot(const FrigateResponse& resp, const String& filename, const DownloadJob& job,
+                                      unsigned long start, int quality) {
+  unsigned long ttfb = frigateConn.stats().lastTtfbMs;
+  int len = resp.contentLength;
+  if (len > 0 && (size_t)len > MAX_SNAPSHOT_BYTES) {
+    Serial.println("[ERROR] Image too large: " + String(len) + " bytes");
+    frigateConn.release(false);
+    return DOWNLOAD_TOO_LARGE;
+  }
+  Serial.println("[DEBUG] Image size: " + (len >= 0 ? String(len) + " bytes" : String(resp.chunked ? "chunked" : "unknown")));
+
+  HttpBodyReader body(frigateConn.client(), len, resp.chunked, 10000);
+  size_t written = 0;
+  DownloadResult result;
+  TeeStats tee;
+
+  // Claim the panel until the result is posted so loop() cannot draw over the
+  // image before it knows the event screen is up
+  bool teeToPanel = SNAPSHOT_TEE_DECODE && job.display;
+  if (teeToPanel) claimPanel();
+  jobQueue.started(job);
+  if (teeToPanel) {
+    TftJpegSink panel;
+    result = streamJpegToFile(body, filename, &written, &panel, &tee);
+  } else {
+    result = streamJpegToFile(body, filename, &written, nullptr, &tee);
+  }
+  jobQueue.finished();
+  frigateConn.release(body.complete());
+
+  if (result == DOWNLOAD_OK) {
+    // Link throughput: the tee decode and SD writes in between reads do not count
+    snapshotQuality.record(quality, written, ttfb, body.readMs());
+  } else if (result == DOWNLOAD_NETWORK_ERROR || result == DOWNLOAD_INCOMPLETE_JPEG) {
+    snapshotQuality.recordFailure();
+  }
+
+  if (result == DOWNLOAD_OK) {
+    eventIndex.add(filename, written, job.camera, job.zone);
+    eventIndex.setValidators(filename, resp.etag, resp.lastModified);
+    requestRetentionSweep();
+    Serial.printf("[DEBUG] Image saved: %s (%u bytes in %lu ms)\n", filename.c_str(), (unsigned)written, millis() - start);
+    recordTeeLatency(job, tee);
+    DownloadJob traced = job;
+    traceDownload(traced, resp, tee);
+    postResult(traced, filename, true, "", tee.decoded);
+  } else if (result == DOWNLOAD_TOO_LARGE) {
+    Serial.println("[ERROR] Image exceeded " + String(MAX_SNAPSHOT_BYTES) + " bytes");
+  } else if (result == DOWNLOAD_CANCELLED) {
+    Serial.printf("[QUEUE] Preempted after %u bytes: %s\n", (unsigned)written, filename.c_str());
+  } else {
+    Serial.printf("[WARNING] Download failed: %s after %u bytes\n", downloadResultToString(result), (unsigned)written);
+  }
+
+  if (teeToPanel) releasePanel();
+  return result;
+}
+
+// ------------------------
+//  Snapshots from MQTT
+// ------------------------
+// Saves, and for a display job decodes to the panel, the snapshot that came
+// with the job. Nothing is asked of Frigate, so this also runs while the
+// breaker is open. Frees the buffer; false means fetch it over HTTP instead.
+static bool saveJobSnapshot(DownloadJob& job) {
+  uint8_t* data = job.jpeg;
+  size_t size = job.jpegSize;
+  job.jpeg = nullptr;
+  job.jpegSize = 0;
+
+  String filename = snapshotFilename(job.url, job.zone);
+  if (eventIndex.contains(filename)) {
+    free(data);
+    postResult(job, filename, true, "");
+    return true;
+  }
+
+  size_t written = 0;
+  DownloadResult result;
+  TeeStats tee;
+  unsigned long start = millis();
+  bool teeToPanel = SNAPSHOT_TEE_DECODE && job.display;
+  if (teeToPanel) {
+    claimPanel();
+    TftJpegSink panel;
+    result = saveJpegToFile(data, size, filename, &written, &panel, &tee);
+  } else {
+    result = saveJpegToFile(data, size, filename, &written, nullptr, &tee);
+  }
+  free(data);
+
+  if (result == DOWNLOAD_OK) {
+    eventIndex.add(filename, written, job.camera, job.zone);
+    requestRetentionSweep();
+    Serial.printf("[MQTT] Snapshot saved: %s (%u bytes in %lu ms)\n", filename.c_str(), (unsigned)written, millis() - start);
+    recordTeeLatency(job, tee);
+    DownloadJob traced = job;
+    if (traced.trace.active()) {
+      traced.trace.stamp(STAGE_SAVED, tee.savedAt);
+      if (tee.decoded) {
+        traced.trace.stamp(STAGE_DECODE_START, tee.decodeStartAt);
+        traced.trace.stamp(STAGE_LAST_MCU, tee.lastPixelAt);
+        traced.trace.tee = true;
+      }
+      traced.trace.attempts = 1;
     }
-    setScreen("event", displayDuration, "displayImageFromAPI");
+    postResult(traced, filename, true, "", tee.decoded);
+  } else {
+    Serial.printf("[MQTT] Snapshot not usable (%s), fetching over HTTP\n", downloadResultToString(result));
+  }
+
+  if (teeToPanel) releasePanel();
+  return result == DOWNLOAD_OK;
+}
+
+// Saves the jobs that brought their snapshot and compacts the rest to the front
+static int saveJobSnapshots(DownloadJob* jobs, int count) {
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (jobs[i].jpeg && saveJobSnapshot(jobs[i])) continue;
+    jobs[kept++] = jobs[i];
+  }
+  return kept;
+}
+
+// ------------------------
+//  Retry scheduling
+// ------------------------
+// Failed jobs wait here for their backoff instead of blocking the task, and
+// jobs park here while the breaker is open. Download task only.
+struct PendingRetry {
+  DownloadJob job;
+  unsigned long dueAt;
+};
+static std::vector<PendingRetry> pendingRetries;
+
+static void scheduleRetry(DownloadJob job, bool countAttempt) {
+  String filename = snapshotFilename(job.url, job.zone);
+  if (countAttempt) job.attempts++;
+
+  if (job.attempts >= FRIGATE_MAX_ATTEMPTS) {
+    Serial.println("[ERROR] Failed to load image after " + String(FRIGATE_MAX_ATTEMPTS) + " attempts");
+    frigateRetryStats.exhausted++;
+    postResult(job, filename, false, "Loading failed");
+    return;
+  }
+  if (millis() - job.queuedAt > FRIGATE_RETRY_MAX_AGE) {
+    Serial.println("[ERROR] Gave up on stale image: " + filename);
+    frigateRetryStats.expired++;
+    postResult(job, filename, false, "Frigate unreachable");
+    return;
+  }
+  if (pendingRetries.size() >= FRIGATE_RETRY_SLOTS) {
+    frigateRetryStats.dropped++;
+    postResult(job, filename, false, "Retry queue full");
     return;
   }
 
-  while (tries < maxTries && !success) {
-    Serial.print("[DEBUG] Attempt "); Serial.print(tries + 1); Serial.print("/"); Serial.println(url);
-    
-    unsigned long timeAgoMillis = millis() - lastFrigateRequest;
+  unsigned long wait = countAttempt ? backoffDelay(job.attempts - 1, FRIGATE_RETRY_BASE_DELAY, FRIGATE_RETRY_MAX_DELAY) : 0;
+  pendingRetries.push_back({job, millis() + wait});
+  frigateRetryStats.scheduled++;
+  frigateRetryStats.pending = pendingRetries.size();
+  if (countAttempt) {
+    Serial.printf("[FRIGATE] Retry %d/%d in %lu ms: %s\n", job.attempts + 1, FRIGATE_MAX_ATTEMPTS, wait, filename.c_str());
+  }
+}
 
-    if (timeAgoMillis < 10000) {
-      Serial.printf("[FRIGATE] Last Frigate Request: %lums ago\n", timeAgoMillis);
+// Moves retries whose backoff has elapsed into jobs[], up to max
+static int takeDueRetries(DownloadJob* jobs, int max) {
+  int count = 0;
+  unsigned long now = millis();
+  for (auto it = pendingRetries.begin(); it != pendingRetries.end() && count < max;) {
+    if ((long)(now - it->dueAt) >= 0) {
+      jobs[count++] = it->job;
+      it = pendingRetries.erase(it);
     } else {
-      Serial.printf("[FRIGATE] Last Frigate Request: %lus ago\n", timeAgoMillis / 1000);
+      ++it;
     }
+  }
+  frigateRetryStats.pending = pendingRetries.size();
+  return count;
+}
 
-    lastFrigateRequest = millis();
+// Parked jobs must not outlive their usefulness, even while nothing is being retried
+static void expireStaleRetries() {
+  unsigned long now = millis();
+  for (auto it = pendingRetries.begin(); it != pendingRetries.end();) {
+    if (now - it->job.queuedAt > FRIGATE_RETRY_MAX_AGE) {
+      String filename = snapshotFilename(it->job.url, it->job.zone);
+      Serial.println("[ERROR] Gave up on stale image: " + filename);
+      frigateRetryStats.expired++;
+      postResult(it->job, filename, false, "Frigate unreachable");
+      it = pendingRetries.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  frigateRetryStats.pending = pendingRetries.size();
+}
 
-    http.end(); // Ensure previous connection is closed
-    http.setTimeout(10000);
-    http.begin(url);
+// How long the task may block waiting for new jobs
+static unsigned long nextWakeDelay() {
+  unsigned long wait = 1000;
+  if (frigateBreaker.isOpen()) return min(wait, max(frigateBreaker.probeWait(), 1UL));
+  unsigned long now = millis();
+  for (const PendingRetry& retry : pendingRetries) {
+    long due = (long)(retry.dueAt - now);
+    wait = min(wait, (unsigned long)max(due, 1L));
+  }
+  return wait;
+}
 
-    unsigned long start = millis();
-    int httpCode = http.GET();
-    unsigned long end = millis();
-
-    Serial.printf("[FRIGATE] Elapsed GET time: %lu ms\n", end - start);
-
-    if (httpCode == 200) {
-      uint32_t len = http.getSize();
-      if (len > MAX_FILE_SIZE) {
-        Serial.println("[ERROR] Image too large: " + String(len) + " bytes");
-        setScreen("error", 10, "displayImageFromAPI");
-        tft.setCursor(10, 30);
-        tft.setTextColor(TFT_RED);
-        tft.setTextSize(2);
-        tft.println("Image too large");
-        http.end();
-        return;
-      }
-      Serial.println("[DEBUG] Image size: " + String(len) + " bytes");
-
-      // Remove oldest image if maxImages is reached
-      int jpgCount = 0;
-      String oldestFile = "";
-      unsigned long oldestTime = ULONG_MAX;
-      File root = SD_MMC.open("/events");
-      if (root && root.isDirectory()) {
-        File file = root.openNextFile();
-        while (file) {
-          String fname = file.name();
-          if (fname.endsWith(".jpg")) {
-            jpgCount++;
-            if (!fname.startsWith("/")) {
-              fname = "/events/" + fname;
-            }
-            unsigned long mtime = file.getLastWrite();
-            if (mtime < oldestTime) {
-              oldestTime = mtime;
-              oldestFile = fname;
-            }
-          }
-          file.close();
-          file = root.openNextFile();
-        }
-        root.close();
-        if (jpgCount >= maxImages && !oldestFile.isEmpty()) {
-          SD_MMC.remove(oldestFile);
-          Serial.println("[DEBUG] Removed: " + oldestFile);
-        }
-      }
+// Frigate answered, even if not with the image: the server itself is up
+static void recordHttpOutcome(int httpCode) {
+  if (httpCode > 0 && httpCode < 500) frigateBreaker.recordSuccess();
+  else frigateBreaker.recordFailure();
+}
 
-      WiFiClient *stream = http.getStreamPtr();
-      uint8_t *jpgData = (uint8_t*)malloc(len);
-      if (!jpgData) {
-        Serial.println("[ERROR] Memory allocation failed!");
-        http.end();
-        return;
-      }
+// ------------------------
+//  Conditional refresh
+// ------------------------
+// Asks Frigate for a snapshot already on the card, quoting its validators so an
+// unchanged image costs a 304 and no body. Frigate's snapshot endpoint sends no
+// validators, so then only a change reported by frigate/events fetches the
+// image again; a review update alone never does. Failures are dropped: the old
+// snapshot is still good, so a refresh is never retried.
+static void refreshSnapshot(const DownloadJob& job) {
+  String url = job.url;
+  String filename = snapshotFilename(url, job.zone);
+  if (frigateBreaker.isOpen()) return;
 
-      if (stream->available()) {
-        size_t bytesRead = stream->readBytes((char*)jpgData, len);
-        File file = SD_MMC.open(filename, FILE_WRITE);
-        if (file) {
-          size_t written = file.write(jpgData, len);
-          file.close();
-          if (written == len) {
-            Serial.println("[DEBUG] Image saved: " + filename);
-            success = true;
-            if (std::find(jpgQueue.begin(), jpgQueue.end(), filename) == jpgQueue.end()) {
-              jpgQueue.push_back(filename);
-            }
-            setScreen("event", displayDuration, "displayImageFromAPI");
-          }
-        }
-        free(jpgData);
-      }
-      http.end();
+  String etag, lastModified;
+  if (!eventIndex.validators(filename, etag, lastModified) ||
+      (etag.isEmpty() && lastModified.isEmpty() && !job.changed)) {
+    refreshStats.skipped++;
+    return;
+  }
+
+  String headers;
+  if (!etag.isEmpty()) headers += "If-None-Match: " + etag + "\r\n";
+  if (!lastModified.isEmpty()) headers += "If-Modified-Since: " + lastModified + "\r\n";
+
+  // A quality changed since the download is a different image and comes back in full
+  String requestUrl = snapshotQuality.apply(url);
+  int quality = requestUrl != url ? snapshotQuality.quality() : -1;
+
+  FrigateResponse resp;
+  unsigned long start = millis();
+  lastFrigateRequest = start;
+  int httpCode = frigateConn.get(requestUrl, resp, 10000, headers);
+  recordHttpOutcome(httpCode);
+
+  if (httpCode == 304) {
+    frigateConn.release(true);
+    refreshStats.notModified++;
+    Serial.printf("[REFRESH] Unchanged: %s (%lu ms)\n", filename.c_str(), millis() - start);
+  } else if (httpCode == 200) {
+    if (receiveSnapshot(resp, filename, job, start, quality) == DOWNLOAD_OK) {
+      refreshStats.updated++;
+      Serial.println("[REFRESH] Updated: " + filename);
     } else {
-      Serial.println("[WARNING] HTTP GET failed: " + String(httpCode) + " - " + http.getString());
-      http.end();
-      tries++;
-      delay(2000);
+      refreshStats.failed++;
     }
+  } else {
+    if (httpCode > 0) frigateConn.readSmallBody(resp);
+    refreshStats.failed++;
+    Serial.println("[REFRESH] Failed: " + filename + " " + String(httpCode > 0 ? String(httpCode) : frigateErrorToString(httpCode)));
   }
+}
 
-  if (!success) {
-    Serial.println("[ERROR] Failed to load image after " + String(maxTries) + " attempts");
-    setScreen("error", 10, "displayImageFromAPI");
-    tft.setCursor(10, 30);
-    tft.setTextColor(TFT_RED);
-    tft.setTextSize(2);
-    tft.println("Loading failed");
+// A download cancelled for a more important job waits behind it. One cut off
+// while drawing leaves the panel to the job that preempted it and only joins
+// the slideshow, instead of drawing over it again.
+static void requeuePreempted(DownloadJob job) {
+  job.display = false;
+  jobQueue.push(job);
+}
+
+// ------------------------
+//  Fetch snapshot from API
+// ------------------------
+// One attempt; failures are rescheduled with backoff. Runs on the download task
+// only and reports back to the UI through downloadResults.
+static void fetchSnapshot(const DownloadJob& job) {
+  if (job.refresh) {
+    refreshSnapshot(job);
+    return;
+  }
+
+  String url = job.url;
+  String filename = snapshotFilename(url, job.zone);
+
+  // Skip if image already exists
+  if (eventIndex.contains(filename)) {
+    Serial.print("[DEBUG] Image already exists: "); Serial.println(filename);
+    postResult(job, filename, true, "");
+    return;
+  }
+
+  // An earlier job in this batch tripped the breaker
+  if (frigateBreaker.isOpen()) {
+    scheduleRetry(job, false);
+    return;
+  }
+
+  Serial.print("[DEBUG] Attempt "); Serial.print(job.attempts + 1); Serial.print("/"); Serial.println(url);
+
+  unsigned long timeAgoMillis = millis() - lastFrigateRequest;
+
+  if (timeAgoMillis < 10000) {
+    Serial.printf("[FRIGATE] Last Frigate Request: %lums ago\n", timeAgoMillis);
+  } else {
+    Serial.printf("[FRIGATE] Last Frigate Request: %lus ago\n", timeAgoMillis / 1000);
+  }
+
+  lastFrigateRequest = millis();
+
+  String requestUrl = snapshotQuality.apply(url);
+  int quality = requestUrl != url ? snapshotQuality.quality() : -1;
+
+  FrigateResponse resp;
+  unsigned long start = millis();
+  int httpCode = frigateConn.get(requestUrl, resp, 10000);
+  unsigned long end = millis();
+
+  const FrigateConnStats& stats = frigateConn.stats();
+  Serial.printf("[FRIGATE] Elapsed GET time: %lu ms (TTFB %lu ms)\n", end - start, stats.lastTtfbMs);
+
+  recordHttpOutcome(httpCode);
+  if (httpCode == 200) {
+    DownloadResult result = receiveSnapshot(resp, filename, job, start, quality);
+    if (result == DOWNLOAD_TOO_LARGE) {
+      postResult(job, filename, false, "Image too large");
+    } else if (result == DOWNLOAD_CANCELLED) {
+      requeuePreempted(job); // not its fault, try again once the urgent job is done
+    } else if (result != DOWNLOAD_OK) {
+      scheduleRetry(job, true);
+    }
+  } else if (httpCode > 0) {
+    // 404 is common while Frigate is still writing the snapshot
+    Serial.println("[WARNING] HTTP GET failed: " + String(httpCode) + " - " + frigateConn.readSmallBody(resp));
+    scheduleRetry(job, true);
+  } else {
+    Serial.println("[WARNING] HTTP GET failed: " + String(frigateErrorToString(httpCode)));
+    if (httpCode == FRIGATE_ERR_RESPONSE) snapshotQuality.recordFailure();
+    scheduleRetry(job, true);
   }
 }
 
+// First glance for a new event: fetch the thumbnail and decode it, enlarged,
+// straight from the socket to the panel. The snapshot tee later draws over it
+// block by block, so the panel never goes black in between.
+static void showThumbnail(const DownloadJob& job) {
+  String url = thumbnailUrl(job.url);
+  if (url.isEmpty() || eventIndex.contains(snapshotFilename(job.url, job.zone))) return;
 
+  FrigateResponse resp;
+  unsigned long start = millis();
+  int httpCode = frigateConn.get(url, resp, FRIGATE_THUMBNAIL_TIMEOUT);
+  recordHttpOutcome(httpCode);
+  if (httpCode != 200) {
+    if (httpCode > 0) frigateConn.readSmallBody(resp);
+    Serial.println("[THUMB] Not available: " + String(httpCode > 0 ? String(httpCode) : frigateErrorToString(httpCode)));
+    return;
+  }
 
-void frigateKeepAlive() { 
-   if (WiFi.status() == WL_CONNECTED) {
+  HttpBodyReader body(frigateConn.client(), resp.contentLength, resp.chunked, FRIGATE_THUMBNAIL_TIMEOUT);
+  // Claim the panel until loop() has been told, as with the snapshot tee
+  claimPanel();
+  ScaledTftJpegSink panel;
+  bool drawn = streamJpegToSink(body, panel);
+  frigateConn.release(body.complete());
+  if (drawn) {
+    postPreview(job);
+    displayLatency.thumbEvents++;
+    displayLatency.thumbFirstGlanceMs = millis() - job.queuedAt;
+    displayLatency.thumbFirstGlanceTotalMs += displayLatency.thumbFirstGlanceMs;
+    Serial.printf("[THUMB] First glance %lu ms after the event (%u bytes in %lu ms)\n",
+                  displayLatency.thumbFirstGlanceMs, (unsigned)body.bytesRead(), millis() - start);
+  }
+  releasePanel();
+}
 
-    http.end(); // Ensure any previous instance is closed
+// Pipelines several snapshot GETs on the keep-alive socket so a busy review costs
+// one round trip instead of one per detection. Anything the pipeline cannot
+// deliver falls back to a single fetchSnapshot() attempt.
+static void fetchSnapshotBatch(const DownloadJob* jobs, int count) {
+  String urls[FRIGATE_PIPELINE_DEPTH];
+  String filenames[FRIGATE_PIPELINE_DEPTH];
+  int qualities[FRIGATE_PIPELINE_DEPTH];
+  int indexes[FRIGATE_PIPELINE_DEPTH];
+  bool done[FRIGATE_PIPELINE_DEPTH] = {};
+  bool preempted = false;
+  int pending = 0;
 
-    String healthCheckUrl = "http://" + frigateIP + ":" + String(frigatePort) + "/api/version";
-    http.setTimeout(10000);// needs to be long enough to allow for the initial connection which can take 8-14 seconds
-    
-    http.begin(healthCheckUrl);
+  for (int i = 0; i < count; i++) {
+    // Conditional requests carry their own headers, they go one by one
+    if (jobs[i].refresh) continue;
+    String filename = snapshotFilename(jobs[i].url, jobs[i].zone);
+    if (eventIndex.contains(filename)) {
+      Serial.print("[DEBUG] Image already exists: "); Serial.println(filename);
+      postResult(jobs[i], filename, true, "");
+      done[i] = true;
+      continue;
+    }
+    // A speculative fetch of a file the review's own job already asks for
+    if (jobs[i].speculative && std::find(filenames, filenames + pending, filename) != filenames + pending) {
+      done[i] = true;
+      continue;
+    }
+    urls[pending] = snapshotQuality.apply(jobs[i].url);
+    qualities[pending] = urls[pending] != jobs[i].url ? snapshotQuality.quality() : -1;
+    filenames[pending] = filename;
+    indexes[pending] = i;
+    pending++;
+  }
 
+  if (pending > 1) {
+    lastFrigateRequest = millis();
     unsigned long start = millis();
-    int httpCode = http.GET();
-    unsigned long end = millis();
+    int sent = frigateConn.sendPipelined(urls, pending, 10000);
+    Serial.printf("[FRIGATE] Pipelined %d/%d snapshot requests\n", sent, pending);
 
-    if (end - start > 100) {
-      Serial.printf("[FRIGATE] Keep-alive took > 100ms: %lu ms\n", end - start);
+    for (int i = 0; i < sent; i++) {
+      FrigateResponse resp;
+      int httpCode = frigateConn.readPipelined(resp, 10000);
+      recordHttpOutcome(httpCode);
+      if (httpCode == 200) {
+        DownloadResult result = receiveSnapshot(resp, filenames[i], jobs[indexes[i]], start, qualities[i]);
+        if (result == DOWNLOAD_OK) {
+          done[indexes[i]] = true;
+        } else if (result == DOWNLOAD_TOO_LARGE) {
+          postResult(jobs[indexes[i]], filenames[i], false, "Image too large");
+          done[indexes[i]] = true;
+        } else if (result == DOWNLOAD_CANCELLED) {
+          requeuePreempted(jobs[indexes[i]]);
+          done[indexes[i]] = true;
+          preempted = true;
+          break;
+        } else {
+          scheduleRetry(jobs[indexes[i]], true);
+          done[indexes[i]] = true;
+        }
+      } else if (httpCode > 0) {
+        // Answered, just not with the image: an attempt like any other, backoff included
+        Serial.println("[WARNING] HTTP GET failed: " + String(httpCode) + " - " + frigateConn.readSmallBody(resp));
+        scheduleRetry(jobs[indexes[i]], true);
+        done[indexes[i]] = true;
+      }
+      if (!frigateConn.connected()) break;
     }
+    // Unread responses would be mistaken for the next request's; start clean
+    if (frigateConn.pipelineBacklog() > 0) frigateConn.close();
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (done[i]) continue;
+    // Left: requests never sent or never answered. A more important job
+    // arrived: everything left waits behind it
+    if (preempted) jobQueue.push(jobs[i]);
+    else fetchSnapshot(jobs[i]);
+  }
+}
+
+// Logs the Frigate version; run once from the worker, which also warms up the connection.
+// Doubles as the cheap probe while the breaker is open.
+static bool frigateCheckVersion() {
+  if (WiFi.status() != WL_CONNECTED || frigateIP.isEmpty()) {
+    if (frigateBreaker.probeDue()) frigateBreaker.deferProbe();
+    return false;
+  }
+
+  String healthCheckUrl = "http://" + frigateIP + ":" + String(frigatePort) + "/api/version";
+  Serial.println("[FRIGATE] Sending GET: " + healthCheckUrl);
+
+  // Only a request that goes out counts as the probe
+  bool probing = frigateBreaker.probeDue();
+  if (probing) frigateBreaker.beginProbe();
+
+  FrigateResponse resp;
+  unsigned long start = millis();
+  int httpCode = frigateConn.get(healthCheckUrl, resp, probing ? FRIGATE_PROBE_TIMEOUT : FRIGATE_CONNECT_TIMEOUT);
+  lastFrigateRequest = millis();
+  Serial.printf("[FRIGATE] Elapsed time: %lu ms\n", millis() - start);
+
+  recordHttpOutcome(httpCode);
+  if (httpCode == 200) {
+    Serial.println("[FRIGATE] Successfully connected to Frigate API at: " + healthCheckUrl);
+    Serial.println("[FRIGATE] Frigate API v" + frigateConn.readSmallBody(resp));
+    return true;
+  } else if (httpCode > 0) {
+    Serial.println("[ERROR] failed connecting to Frigate API at: " + healthCheckUrl + " with code: " + String(httpCode));
+    frigateConn.readSmallBody(resp);
+  } else {
+    Serial.println("[ERROR] failed connecting to Frigate API at: " + healthCheckUrl + ": " + String(frigateErrorToString(httpCode)));
+  }
+  return false;
+}
 
-    if (httpCode != 200) {
-      Serial.printf("[FRIGATE] Keep-alive failed with code: %d\n", httpCode);
-      Serial.println("[FRIGATE] HTTP error message: " + http.errorToString(httpCode));
+// ------------------------
+//  Boot backfill
+// ------------------------
+// Lets ArduinoJson parse straight from the socket
+struct BodyJsonReader {
+  HttpBodyReader& body;
+  int read() {
+    uint8_t c;
+    return body.read(&c, 1) == 1 ? c : -1;
+  }
+  size_t readBytes(char* buf, size_t len) {
+    size_t n = 0;
+    while (n < len) {
+      int r = body.read((uint8_t*)buf + n, len - n);
+      if (r <= 0) break;
+      n += r;
     }
+    return n;
+  }
+};
+
+// Snapshots of recent reviews not yet on the card, fetched when nothing live is waiting
+static std::vector<DownloadJob> backfillJobs;
+
+// Asks Frigate for the latest reviews and reconciles them with /events: missing
+// snapshots are queued for download, reviews still within displayDuration go
+// back on screen as if MQTT had just delivered them, and older ones join
+// galleryQueue without taking the screen. Returns false to try again later.
+static bool runBackfill() {
+  backfillStats.reviews = 0;
+  backfillStats.existing = 0;
+  backfillStats.queued = 0;
 
-    http.end();
+  String url = "http://" + frigateIP + ":" + String(frigatePort) + "/api/review?limit=" + String(FRIGATE_BACKFILL_REVIEWS);
+  FrigateResponse resp;
+  int httpCode = frigateConn.get(url, resp, 10000);
+  recordHttpOutcome(httpCode);
+  if (httpCode != 200) {
+    if (httpCode > 0) frigateConn.readSmallBody(resp);
+    Serial.println("[BACKFILL] Review query failed: " + String(httpCode > 0 ? String(httpCode) : frigateErrorToString(httpCode)));
+    return httpCode > 0; // an HTTP error will not fix itself, e.g. a Frigate without the review API
   }
-}
\ No newline at end of file
+
+  JsonDocument filter;
+  filter[0]["camera"] = true;
+  filter[0]["end_time"] = true;
+  filter[0]["severity"] = true;
+  filter[0]["data"]["detections"] = true;
+  filter[0]["data"]["zones"] = true;
+  filter[0]["data"]["objects"] = true;
+
+  JsonDocument doc;
+  HttpBodyReader body(frigateConn.client(), resp.contentLength, resp.chunked, 10000);
+  BodyJsonReader reader{body};
+  DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(filter));
+  while (reader.read() >= 0) {
+  }
+  frigateConn.release(body.complete());
+  if (error) {
+    Serial.println("[BACKFILL] Parse error: " + String(error.c_str()));
+    return false;
+  }
+
+  time_t now = time(nullptr);
+  bool clockValid = now > 1600000000;
+  size_t budget = maxImages;
+  std::vector<DownloadJob> found;
+
+  // Reviews come newest first; keep the newest maxImages detections
+  for (JsonVariant review : doc.as<JsonArray>()) {
+    backfillStats.reviews++;
+    FilterDecision decision = filterRules.match(review.as<JsonObject>());
+    if (!decision.show) continue;
+
+    String camera = review["camera"] | "";
+    JsonArray zones = review["data"]["zones"].as<JsonArray>();
+    String zone = (!zones.isNull() && zones.size() > 0) ? zones[zones.size() - 1].as<String>() : String("outside-zone");
+    // An open review has no end_time yet
+    double endTime = review["end_time"] | 0.0;
+    bool live = review["end_time"].isNull() || (clockValid && now - (time_t)endTime < displayDuration);
+
+    for (JsonVariant d : review["data"]["detections"].as<JsonArray>()) {
+      if (found.size() >= budget) break;
+      DownloadJob job = {};
+      String snapshotUrl = frigateSnapshotUrl(d.as<String>());
+      if (snapshotUrl.length() >= sizeof(job.url)) continue;
+      strlcpy(job.url, snapshotUrl.c_str(), sizeof(job.url));
+      strlcpy(job.camera, camera.c_str(), sizeof(job.camera));
+      strlcpy(job.zone, zone.c_str(), sizeof(job.zone));
+      job.backfill = !live;
+      job.displaySec = decision.durationSec;
+      job.rank = eventRank(decision.priority, review["severity"] | "");
+      found.push_back(job);
+    }
+  }
+
+  // Oldest first, so the slideshow order and retention match a live arrival
+  for (auto it = found.rbegin(); it != found.rend(); ++it) {
+    DownloadJob& job = *it;
+    String filename = snapshotFilename(job.url, job.zone);
+    if (eventIndex.contains(filename)) {
+      backfillStats.existing++;
+      job.queuedAt = millis();
+      postResult(job, filename, true, "");
+    } else {
+      backfillStats.queued++;
+      backfillJobs.push_back(job);
+    }
+  }
+  Serial.printf("[BACKFILL] %u reviews: %u snapshots on card, %u to fetch\n",
+                (unsigned)backfillStats.reviews, (unsigned)backfillStats.existing, (unsigned)backfillStats.queued);
+  return true;
+}
+
+// Moves up to max backfill jobs into jobs[]
+static int takeBackfillJobs(DownloadJob* jobs, int max) {
+  int count = 0;
+  while (count < max && !backfillJobs.empty()) {
+    jobs[count] = backfillJobs.front();
+    jobs[count].queuedAt = millis(); // the retry age limit starts now
+    backfillJobs.erase(backfillJobs.begin());
+    count++;
+  }
+  return count;
+}
+
+// ------------------------
+//  Download worker task
+// ------------------------
+// Owns the Frigate connection: snapshots and reconnects both run here so
+// network stalls never reach loop().
+static void downloadTaskMain(void* arg) {
+  frigateCheckVersion();
+
+  DownloadJob jobs[FRIGATE_PIPELINE_DEPTH];
+  while (true) {
+    // Best first, plus whatever else is already queued, e.g. the other detections of a review
+    int count = jobQueue.take(jobs, FRIGATE_PIPELINE_DEPTH, pdMS_TO_TICKS(nextWakeDelay()));
+    count = saveJobSnapshots(jobs, count);
+    expireStaleRetries();
+
+    if (frigateBreaker.isOpen()) {
+      // Park new work and only spend a cheap probe on the server until it answers
+      for (int i = 0; i < count; i++) scheduleRetry(jobs[i], false);
+      if (frigateBreaker.probeDue()) frigateCheckVersion();
+      continue;
+    }
+
+    count += takeDueRetries(jobs + count, FRIGATE_PIPELINE_DEPTH - count);
+
+    // Backfill once Frigate is reachable, and only while nothing live is waiting
+    if (count == 0 && !backfillStats.done && WiFi.status() == WL_CONNECTED && !frigateIP.isEmpty() &&
+        (backfillStats.lastAttemptAt == 0 || millis() - backfillStats.lastAttemptAt > FRIGATE_BACKFILL_RETRY_INTERVAL)) {
+      backfillStats.lastAttemptAt = millis();
+      backfillStats.done = runBackfill();
+      continue;
+    }
+    if (count == 0) count = takeBackfillJobs(jobs, FRIGATE_PIPELINE_DEPTH);
+
+    // Only a fresh display job is queued first; retries keep whatever is on screen
+    if (PROGRESSIVE_THUMBNAIL && count > 0 && jobs[0].display && jobs[0].attempts == 0) {
+      showThumbnail(jobs[0]);
+    }
+    if (count > 0) {
+      fetchSnapshotBatch(jobs, count);
+    } else {
+      frigateConn.maintain();
+    }
+  }
+}
+
+void startDownloadTask() {
+  if (downloadTask) return;
+  jobQueue.begin();
+  downloadResults = xQueueCreate(DOWNLOAD_RESULT_QUEUE_LENGTH, sizeof(DownloadResultMsg));
+  xTaskCreatePinnedToCore(downloadTaskMain, "download", DOWNLOAD_TASK_STACK, nullptr, 1, &downloadTask, DOWNLOAD_TASK_CORE);
+}
+
+bool queueSnapshotDownload(const String& url, const String& camera, const String& zone, bool priority,
+                           unsigned long receivedAt, uint8_t* jpeg, size_t jpegSize,
+                           uint16_t displaySec, uint8_t rank) {
+  DownloadJob job = {};
+  if (url.length() >= sizeof(job.url)) {
+    Serial.println("[FRIGATE] URL too long, not queued: " + url);
+    free(jpeg);
+    return false;
+  }
+  strlcpy(job.url, url.c_str(), sizeof(job.url));
+  strlcpy(job.camera, camera.c_str(), sizeof(job.camera));
+  strlcpy(job.zone, zone.c_str(), sizeof(job.zone));
+  job.display = priority;
+  job.attempts = 0;
+  job.queuedAt = millis();
+  job.jpeg = jpeg;
+  job.jpegSize = jpegSize;
+  job.displaySec = displaySec;
+  job.rank = rank;
+  if (receivedAt != 0) {
+    job.trace.stamp(STAGE_MQTT, receivedAt);
+    job.trace.stamp(STAGE_URL);
+  }
+  if (!jobQueue.push(job)) {
+    Serial.println("[FRIGATE] Download queue full, dropped: " + url);
+    return false;
+  }
+  return true;
+}
+
+bool queueSpeculativeDownload(const String& url, const String& camera, const String& zone) {
+  if (url.length() >= sizeof(DownloadJob::url)) return false;
+  // Ranked below live events, so a full queue evicts these first
+  DownloadJob job = {};
+  strlcpy(job.url, url.c_str(), sizeof(job.url));
+  strlcpy(job.camera, camera.c_str(), sizeof(job.camera));
+  strlcpy(job.zone, zone.c_str(), sizeof(job.zone));
+  job.speculative = true;
+  job.queuedAt = millis();
+  return jobQueue.push(job);
+}
+
+bool queueGalleryDownload(const String& url, const String& camera, const String& zone) {
+  if (url.length() >= sizeof(DownloadJob::url)) return false;
+  DownloadJob job = {};
+  strlcpy(job.url, url.c_str(), sizeof(job.url));
+  strlcpy(job.camera, camera.c_str(), sizeof(job.camera));
+  strlcpy(job.zone, zone.c_str(), sizeof(job.zone));
+  job.backfill = true;
+  job.queuedAt = millis();
+  return jobQueue.push(job);
+}
+
+bool queueSnapshotRefresh(const String& url, const String& camera, const String& zone, bool changed) {
+  if (url.length() >= sizeof(DownloadJob::url)) return false;
+  // Nothing to ask with and no sign of a newer image: not worth a queue slot
+  String etag, lastModified;
+  if (!changed && (!eventIndex.validators(snapshotFilename(url, zone), etag, lastModified) ||
+                   (etag.isEmpty() && lastModified.isEmpty()))) {
+    refreshStats.skipped++;
+    return false;
+  }
+  DownloadJob job = {};
+  strlcpy(job.url, url.c_str(), sizeof(job.url));
+  strlcpy(job.camera, camera.c_str(), sizeof(job.camera));
+  strlcpy(job.zone, zone.c_str(), sizeof(job.zone));
+  job.refresh = true;
+  job.changed = changed;
+  job.queuedAt = millis();
+  if (!jobQueue.push(job)) return false;
+  refreshStats.requested++;
+  return true;
+}
+
+// Called from loop(): applies finished downloads to the UI
+void handleDownloadResults() {
+  if (!downloadResults) return;
+
+  // One "unreachable" screen per outage instead of an error per event
+  static bool outageShown = false;
+  if (frigateBreaker.isOpen() && !outageShown) {
+    outageShown = true;
+    showImageError("Frigate unreachable");
+  } else if (!frigateBreaker.isOpen() && outageShown) {
+    outageShown = false;
+  }
+
+  DownloadResultMsg msg;
+  while (xQueueReceive(downloadResults, &msg, 0) == pdTRUE) {
+    if (msg.preview) {
+      holdEventScreen(msg.displaySec ? msg.displaySec : displayDuration, "thumbnail");
+    } else if (msg.success) {
+      String filename = msg.filename;
+      unsigned long showFor = msg.displaySec ? msg.displaySec : displayDuration;
+      framePrefetch.invalidate(filename); // a re-download may have changed it
+      if (msg.refreshed) {
+        // Not a new event: only redraw if it is what the panel shows
+        redrawEventImage(filename);
+        continue;
+      }
+      if (msg.gallery) {
+        // An older event from the card: kept for the slideshows to come, the screen stays as it is
+        if (std::find(galleryQueue.begin(), galleryQueue.end(), filename) == galleryQueue.end()) {
+          galleryQueue.push_back(filename);
+          if (galleryQueue.size() > (size_t)max(maxImages, 1)) galleryQueue.erase(galleryQueue.begin());
+        }
+        continue;
+      }
+      // The newest event goes last, where the single image view takes it from
+      auto queued = std::find(jpgQueue.begin(), jpgQueue.end(), filename);
+      if (queued != jpgQueue.end()) jpgQueue.erase(queued);
+      jpgQueue.push_back(filename);
+      EventTrace trace = msg.trace;
+      if (msg.drawn) {
+        setScreen("event", showFor, "handleDownloadResults", false);
+      } else {
+        // Outside a slideshow setScreen draws exactly this one; in a running
+        // slideshow it only appears on its turn, so the trace ends at "saved"
+        unsigned long decodeStart = millis();
+        setScreen("event", showFor, "handleDownloadResults");
+        if (!slideshowActive) {
+          trace.stamp(STAGE_DECODE_START, decodeStart);
+          trace.stamp(STAGE_LAST_MCU);
+        }
+        displayLatency.sdEvents++;
+        displayLatency.sdFullFrameMs = millis() - msg.queuedAt;
+        displayLatency.sdFullFrameTotalMs += displayLatency.sdFullFrameMs;
+        Serial.printf("[DEBUG] Event-to-pixel via SD: %lu ms\n", displayLatency.sdFullFrameMs);
+      }
+      latencyTracer.finish(msg.filename, trace);
+    } else if (outageShown) {
+      Serial.println("[FRIGATE] Not shown during outage: " + String(msg.filename) + " (" + msg.error + ")");
+    } else {
+      showImageError(msg.error);
+    }
+  }
+}
@@ -2,6 +2,8 @@
 
 #include <Arduino.h>
 #include <vector>
+#include "latency.h"
+#include "retry.h"
 
 extern String frigateIP;
 extern int frigatePort;
@@ -9,9 +11,147 @@ extern int frigatePort;
 extern unsigned long lastFrigateRequest;
 
 extern std::vector<String> jpgQueue;
-extern bool imagePending;
-extern String pendingImageUrl;
-extern String pendingZone;
+// Older events from the card (boot backfill, replayed reviews), oldest first and
+// at most maxImages. Unlike jpgQueue it survives the return to the clock; every
+// slideshow cycles through it after the live events. loop() only.
+extern std::vector<String> galleryQueue;
 
-void displayImageFromAPI(String url, String zone);
-void frigateKeepAlive();
\ No newline at end of file
+// Download worker, pinned to the core that runs the WiFi stack
+const int DOWNLOAD_TASK_CORE = 0;
+const uint32_t DOWNLOAD_TASK_STACK = 8192;
+const int DOWNLOAD_RESULT_QUEUE_LENGTH = 8;
+// Max snapshot requests written to the keep-alive socket before reading responses
+const int FRIGATE_PIPELINE_DEPTH = 5;
+
+// Retries are scheduled with backoff, never slept on the download task
+const int FRIGATE_MAX_ATTEMPTS = 5;
+const unsigned long FRIGATE_RETRY_BASE_DELAY = 1000;
+const unsigned long FRIGATE_RETRY_MAX_DELAY = 30000;
+const size_t FRIGATE_RETRY_SLOTS = 16;
+// Images not fetched within this time are dropped, e.g. after a long outage
+const unsigned long FRIGATE_RETRY_MAX_AGE = 5UL * 60UL * 1000UL;
+// Consecutive failures before Frigate is considered down, and how often it is probed then
+const int FRIGATE_BREAKER_THRESHOLD = 5;
+const unsigned long FRIGATE_PROBE_MIN_DELAY = 5000;
+const unsigned long FRIGATE_PROBE_MAX_DELAY = 60000;
+const unsigned long FRIGATE_PROBE_TIMEOUT = 3000;
+
+// Decode the first snapshot of an event straight to the panel while it downloads.
+// Build with -DSNAPSHOT_TEE_DECODE=0 to compare against the SD round trip.
+#ifndef SNAPSHOT_TEE_DECODE
+#define SNAPSHOT_TEE_DECODE 1
+#endif
+
+// Two-stage display: paint Frigate's small event thumbnail, enlarged, before the
+// full snapshot has arrived. Build with -DPROGRESSIVE_THUMBNAIL=0 to disable.
+#ifndef PROGRESSIVE_THUMBNAIL
+#define PROGRESSIVE_THUMBNAIL 1
+#endif
+const unsigned long FRIGATE_THUMBNAIL_TIMEOUT = 2000;
+
+// Reviews asked from Frigate after boot to refill /events and the event screen
+const int FRIGATE_BACKFILL_REVIEWS = 20;
+const unsigned long FRIGATE_BACKFILL_RETRY_INTERVAL = 30000;
+
+struct DownloadJob {
+  char url[256];
+  char camera[32];
+  char zone[48];
+  bool display;           // shown as soon as it arrives
+  uint8_t attempts;       // failed attempts so far
+  bool backfill;          // fetched for the gallery, joins galleryQueue without taking the screen
+  bool refresh;           // re-check a snapshot already on the card with a conditional GET
+  bool changed;           // Frigate reported a newer snapshot: fetch it even without validators
+  bool speculative;       // fetched from frigate/events before a review asked, not announced
+  unsigned long queuedAt;
+  EventTrace trace;       // inactive unless the job came from MQTT
+  uint8_t* jpeg;          // snapshot already received over MQTT, owned by the job
+  size_t jpegSize;
+  uint16_t displaySec;    // from the matching filter rule, 0 = displayDuration
+  uint8_t rank;           // see eventRank(); higher is downloaded first
+};
+
+struct DownloadResultMsg {
+  char filename[48];
+  bool success;
+  bool drawn;             // already on the panel, no redraw from SD needed
+  bool preview;           // only the thumbnail is on the panel, the snapshot follows
+  bool refreshed;         // an improved snapshot replaced the one on the card
+  bool gallery;           // an older event from the card, joins galleryQueue without taking the screen
+  uint16_t displaySec;
+  unsigned long queuedAt;
+  char error[24];
+  EventTrace trace;
+};
+
+// Event-to-pixel latency, measured from the moment a job is queued
+struct DisplayLatencyStats {
+  uint32_t teeEvents = 0;
+  unsigned long teeFirstPixelMs = 0;
+  unsigned long teeFullFrameMs = 0;
+  unsigned long teeFirstPixelTotalMs = 0;
+  unsigned long teeFullFrameTotalMs = 0;
+  uint32_t sdEvents = 0;
+  unsigned long sdFullFrameMs = 0;
+  unsigned long sdFullFrameTotalMs = 0;
+  uint32_t thumbEvents = 0;
+  unsigned long thumbFirstGlanceMs = 0;
+  unsigned long thumbFirstGlanceTotalMs = 0;
+};
+
+extern DisplayLatencyStats displayLatency;
+
+struct FrigateRetryStats {
+  uint32_t scheduled = 0;
+  uint32_t exhausted = 0;   // gave up after FRIGATE_MAX_ATTEMPTS
+  uint32_t expired = 0;     // older than FRIGATE_RETRY_MAX_AGE
+  uint32_t dropped = 0;     // no retry slot left
+  size_t pending = 0;
+};
+
+struct BackfillStats {
+  bool done = false;
+  unsigned long lastAttemptAt = 0;
+  uint32_t reviews = 0;
+  uint32_t existing = 0;    // already on the card
+  uint32_t queued = 0;      // missing, fetched in the background
+};
+
+struct RefreshStats {
+  uint32_t requested = 0;
+  uint32_t notModified = 0; // answered 304, no body
+  uint32_t updated = 0;     // a new snapshot replaced the old one
+  uint32_t skipped = 0;     // no validators and no change reported, or the file is gone
+  uint32_t failed = 0;
+};
+
+extern BackfillStats backfillStats;
+extern RefreshStats refreshStats;
+extern CircuitBreaker frigateBreaker;
+extern FrigateRetryStats frigateRetryStats;
+
+void startDownloadTask();
+String frigateSnapshotUrl(const String& eventId);
+// priority jobs are announced on screen and outrank the rest of their rank,
+// e.g. the first detection of a new review.
+// receivedAt is the millis() of the MQTT message, which starts a latency trace.
+// A ps_malloc'd jpeg from the MQTT snapshot topic is saved instead of fetching
+// url, which stays the fallback; the job owns it, also when it is not queued.
+// displaySec and rank come from the filter rule that let the event through.
+bool queueSnapshotDownload(const String& url, const String& camera, const String& zone, bool priority = false,
+                           unsigned long receivedAt = 0, uint8_t* jpeg = nullptr, size_t jpegSize = 0,
+                           uint16_t displaySec = 0, uint8_t rank = 0);
+// The rule's priority first, then alerts over detections
+inline uint8_t eventRank(uint8_t rulePriority, const String& severity) {
+  return min(rulePriority, (uint8_t)127) * 2 + (severity.equalsIgnoreCase("alert") ? 1 : 0);
+}
+// Fetches an object's snapshot as soon as frigate/events reports it, so it is
+// on the card when the review arrives. Never shown by itself.
+bool queueSpeculativeDownload(const String& url, const String& camera, const String& zone);
+// Fetches a snapshot for the gallery without announcing it, like the boot backfill
+bool queueGalleryDownload(const String& url, const String& camera, const String& zone);
+// Re-check of a snapshot already downloaded. Costs a 304 when Frigate has nothing
+// better; skipped without validators unless changed says Frigate has a newer one,
+// e.g. from frigate/events. Ranked below live events.
+bool queueSnapshotRefresh(const String& url, const String& camera, const String& zone, bool changed);
+void handleDownloadResults();
\ No newline at end of file
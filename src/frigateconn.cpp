@@ -0,0 +1,263 @@
+#include "frigateconn.h"
+#include "frigate.h"
+#include "download.h"
+
+FrigateConnection frigateConn;
+
+// ------------------------
+//  DNS cache
+// ------------------------
+bool FrigateConnection::resolve(const String& host, IPAddress& ip) {
+  if (ip.fromString(host)) return true;
+
+  if (host == _dnsHost && _dnsAt != 0 && millis() - _dnsAt < FRIGATE_DNS_TTL) {
+    ip = _dnsIp;
+    return true;
+  }
+
+  unsigned long start = millis();
+  _stats.dnsLookups++;
+  if (!WiFi.hostByName(host.c_str(), ip)) {
+    Serial.println("[FRIGATE] DNS lookup failed for: " + host);
+    _dnsAt = 0;
+    return false;
+  }
+  _stats.lastDnsMs = millis() - start;
+  _dnsHost = host;
+  _dnsIp = ip;
+  _dnsAt = millis();
+  Serial.printf("[FRIGATE] Resolved %s to %s in %lu ms\n", host.c_str(), ip.toString().c_str(), _stats.lastDnsMs);
+  return true;
+}
+
+// ------------------------
+//  Socket lifecycle
+// ------------------------
+bool FrigateConnection::connect(const String& host, uint16_t port, unsigned long timeoutMs) {
+  close();
+  _lastConnectAttempt = millis();
+
+  IPAddress ip;
+  if (!resolve(host, ip)) {
+    _stats.connectFailures++;
+    return false;
+  }
+
+  unsigned long start = millis();
+  if (!_client.connect(ip, port, timeoutMs)) {
+    _stats.connectFailures++;
+    _dnsAt = 0; // the address may have moved
+    Serial.printf("[FRIGATE] Connect to %s:%u failed after %lu ms\n", host.c_str(), port, millis() - start);
+    return false;
+  }
+  _stats.lastConnectMs = millis() - start;
+  _stats.connects++;
+
+  _client.setNoDelay(true);
+  _client.setKeepAlive(30000, 3);
+
+  _connected = true;
+  _host = host;
+  _port = port;
+  Serial.printf("[FRIGATE] Connected to %s:%u in %lu ms\n", host.c_str(), port, _stats.lastConnectMs);
+  return true;
+}
+
+void FrigateConnection::close() {
+  if (_connected) _client.stop();
+  _connected = false;
+  _keepAlive = false;
+  _pipelineBacklog = 0;
+}
+
+// Cheap liveness check: connected() only reads state kept by the AsyncTCP
+// callbacks, and an idle keep-alive socket must not have unread bytes waiting
+bool FrigateConnection::isAlive() {
+  if (!_connected) return false;
+  if (!_client.connected() || _client.available() > 0) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void FrigateConnection::maintain() {
+  if (WiFi.status() != WL_CONNECTED || frigateIP.isEmpty()) return;
+  if (isAlive() && _host == frigateIP && _port == frigatePort) return;
+  if (millis() - _lastConnectAttempt < FRIGATE_RECONNECT_INTERVAL) return;
+  connect(frigateIP, frigatePort, FRIGATE_CONNECT_TIMEOUT);
+}
+
+// ------------------------
+//  Request / response head
+// ------------------------
+bool FrigateConnection::sendRequest(const String& host, uint16_t port, const String& path, const String& headers) {
+  String request = "GET " + path + " HTTP/1.1\r\n" +
+                   "Host: " + host + ":" + String(port) + "\r\n" +
+                   "Connection: keep-alive\r\n" +
+                   "User-Agent: ESP32-Frigate-Viewer\r\n" +
+                   "Accept: image/jpeg, */*\r\n" +
+                   headers + "\r\n";
+  return _client.write((const uint8_t*)request.c_str(), request.length()) == request.length();
+}
+
+FrigateConnection::HeadResult FrigateConnection::readResponseHead(FrigateResponse& resp, unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (!_client.available()) {
+    if (!_client.connected()) return millis() - start < FRIGATE_STALE_CLOSE_MS ? HEAD_CLOSED : HEAD_FAILED;
+    if (millis() - start > timeoutMs) return HEAD_FAILED;
+    delay(1);
+  }
+  _stats.lastTtfbMs = millis() - start;
+  resp.firstByteAt = millis();
+
+  _client.setTimeout(timeoutMs);
+  String statusLine = _client.readStringUntil('\n');
+  statusLine.trim();
+  if (!statusLine.startsWith("HTTP/1.")) return HEAD_FAILED;
+  int space = statusLine.indexOf(' ');
+  if (space < 0) return HEAD_FAILED;
+  resp.status = statusLine.substring(space + 1, space + 4).toInt();
+  resp.keepAlive = statusLine.startsWith("HTTP/1.1");
+  resp.contentLength = -1;
+  resp.chunked = false;
+  resp.etag = "";
+  resp.lastModified = "";
+
+  while (true) {
+    String line = _client.readStringUntil('\n');
+    line.trim();
+    if (line.isEmpty()) break;
+    int colon = line.indexOf(':');
+    if (colon <= 0) continue;
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    value.trim();
+    if (name.equalsIgnoreCase("Content-Length")) {
+      resp.contentLength = value.toInt();
+    } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+      value.toLowerCase();
+      resp.chunked = value.indexOf("chunked") >= 0;
+    } else if (name.equalsIgnoreCase("ETag")) {
+      resp.etag = value;
+    } else if (name.equalsIgnoreCase("Last-Modified")) {
+      resp.lastModified = value;
+    } else if (name.equalsIgnoreCase("Connection")) {
+      value.toLowerCase();
+      if (value.indexOf("close") >= 0) resp.keepAlive = false;
+      if (value.indexOf("keep-alive") >= 0) resp.keepAlive = true;
+    }
+  }
+
+  // These never carry a body, whatever the headers say
+  if (resp.status == 204 || resp.status == 304) {
+    resp.contentLength = 0;
+    resp.chunked = false;
+  }
+  // A body delimited by close can never be followed by another request
+  if (!resp.chunked && resp.contentLength < 0) resp.keepAlive = false;
+  return resp.status > 0 ? HEAD_OK : HEAD_FAILED;
+}
+
+int FrigateConnection::get(const String& url, FrigateResponse& resp, unsigned long timeoutMs, const String& headers) {
+  String host, path;
+  uint16_t port;
+  if (!parseHttpUrl(url, host, port, path)) return FRIGATE_ERR_URL;
+
+  _stats.requests++;
+  _stats.lastRequestAt = millis();
+  _requestStart = millis();
+
+  // Never interleave a new request with unread pipelined responses
+  if (_pipelineBacklog > 0) close();
+
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused = isAlive() && host == _host && port == _port;
+    if (!reused && !connect(host, port, timeoutMs)) return FRIGATE_ERR_CONNECT;
+
+    resp.connectedAt = millis();
+    if (!sendRequest(host, port, path, headers)) {
+      close();
+      if (reused) continue;
+      return FRIGATE_ERR_SEND;
+    }
+    HeadResult head = readResponseHead(resp, timeoutMs);
+    if (head == HEAD_OK) {
+      if (reused) _stats.reusedRequests++;
+      _keepAlive = resp.keepAlive;
+      return resp.status;
+    }
+    close();
+    // The server may have closed an idle socket just as we reused it; retry once
+    // on a fresh one. A timeout or a late close is not that: the request reached
+    // a server that is slow or gone, and asking again would only double the wait.
+    if (!reused || head != HEAD_CLOSED) break;
+  }
+  return FRIGATE_ERR_RESPONSE;
+}
+
+int FrigateConnection::sendPipelined(const String urls[], int count, unsigned long timeoutMs) {
+  String host, path;
+  uint16_t port;
+  if (count <= 0 || !parseHttpUrl(urls[0], host, port, path)) return 0;
+
+  bool reused = isAlive() && host == _host && port == _port;
+  if (!reused && !connect(host, port, timeoutMs)) return 0;
+
+  _pipelineConnectedAt = millis();
+  int sent = 0;
+  for (int i = 0; i < count; i++) {
+    String h, p;
+    uint16_t pt;
+    if (!parseHttpUrl(urls[i], h, pt, p) || h != host || pt != port) break;
+    if (!sendRequest(host, port, p)) break;
+    sent++;
+  }
+
+  _stats.requests += sent;
+  _stats.reusedRequests += reused ? sent : max(sent - 1, 0);
+  _stats.lastRequestAt = millis();
+  _pipelineBacklog = sent;
+  if (sent == 0) close();
+  return sent;
+}
+
+int FrigateConnection::readPipelined(FrigateResponse& resp, unsigned long timeoutMs) {
+  if (!_connected || _pipelineBacklog <= 0) return FRIGATE_ERR_RESPONSE;
+  _requestStart = millis();
+  resp.connectedAt = _pipelineConnectedAt;
+  if (readResponseHead(resp, timeoutMs) != HEAD_OK) {
+    close();
+    return FRIGATE_ERR_RESPONSE;
+  }
+  _pipelineBacklog--;
+  _keepAlive = resp.keepAlive;
+  return resp.status;
+}
+
+void FrigateConnection::release(bool bodyComplete) {
+  _stats.lastTotalMs = millis() - _requestStart;
+  if (!bodyComplete || !_keepAlive) close();
+}
+
+String FrigateConnection::readSmallBody(const FrigateResponse& resp, size_t maxLen) {
+  HttpBodyReader body(_client, resp.contentLength, resp.chunked, 2000);
+  String text;
+  uint8_t buf[64];
+  int n;
+  while ((n = body.read(buf, sizeof(buf))) > 0) {
+    for (int i = 0; i < n && text.length() < maxLen; i++) text += (char)buf[i];
+  }
+  release(body.complete());
+  return text;
+}
+
+const char* frigateErrorToString(int code) {
+  switch (code) {
+    case FRIGATE_ERR_URL: return "invalid URL";
+    case FRIGATE_ERR_CONNECT: return "connection failed";
+    case FRIGATE_ERR_SEND: return "send failed";
+    case FRIGATE_ERR_RESPONSE: return "no response";
+  }
+  return "HTTP error";
+}
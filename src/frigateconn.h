@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "asynchttp.h"
+
+const unsigned long FRIGATE_CONNECT_TIMEOUT = 15000;       // first connect can take 8-14 seconds
+const unsigned long FRIGATE_RECONNECT_INTERVAL = 5000;     // min gap between background reconnects
+const unsigned long FRIGATE_DNS_TTL = 10UL * 60UL * 1000UL; // 10 minutes
+const unsigned long FRIGATE_STALE_CLOSE_MS = 500;          // a reused socket closed this fast never saw the request
+
+// Negative results of FrigateConnection::get(), alongside HTTP status codes
+const int FRIGATE_ERR_URL = -1;
+const int FRIGATE_ERR_CONNECT = -2;
+const int FRIGATE_ERR_SEND = -3;
+const int FRIGATE_ERR_RESPONSE = -4;
+
+struct FrigateResponse {
+  int status = 0;
+  int contentLength = -1;
+  bool chunked = false;
+  bool keepAlive = false;
+  unsigned long connectedAt = 0;   // socket ready, request about to be written
+  unsigned long firstByteAt = 0;
+  String etag;
+  String lastModified;
+};
+
+struct FrigateConnStats {
+  uint32_t requests = 0;
+  uint32_t reusedRequests = 0;
+  uint32_t connects = 0;
+  uint32_t connectFailures = 0;
+  uint32_t dnsLookups = 0;
+  unsigned long lastDnsMs = 0;
+  unsigned long lastConnectMs = 0;
+  unsigned long lastTtfbMs = 0;
+  unsigned long lastTotalMs = 0;
+  unsigned long lastRequestAt = 0;
+};
+
+// ------------------------
+//  Frigate connection manager
+// ------------------------
+// Holds a single persistent HTTP/1.1 keep-alive socket, run by the AsyncTCP
+// task like every other connection. Only used from the download task; stats
+// may be read from other tasks.
+class FrigateConnection {
+public:
+  // Sends a GET and parses the response head. Returns the HTTP status or FRIGATE_ERR_*.
+  // On success the body must be read from client() and then release() called.
+  // headers are extra request lines, each ending in "\r\n".
+  int get(const String& url, FrigateResponse& resp, unsigned long timeoutMs = 10000, const String& headers = "");
+  void release(bool bodyComplete);
+  // Reads a short body as text (for logging) and releases the connection
+  String readSmallBody(const FrigateResponse& resp, size_t maxLen = 256);
+
+  // Pipelining: writes several GETs to the same host back to back, then the
+  // responses are read in order with readPipelined(). Returns requests sent.
+  int sendPipelined(const String urls[], int count, unsigned long timeoutMs = 10000);
+  int readPipelined(FrigateResponse& resp, unsigned long timeoutMs = 10000);
+  int pipelineBacklog() const { return _pipelineBacklog; }
+
+  // Reconnects a dropped socket in the background so the next event finds it warm
+  void maintain();
+  void close();
+  bool isAlive();
+
+  Client& client() { return _client; }
+  const FrigateConnStats& stats() const { return _stats; }
+  bool connected() const { return _connected; }
+
+private:
+  enum HeadResult {
+    HEAD_OK,
+    HEAD_CLOSED,    // closed or reset before a single byte, within FRIGATE_STALE_CLOSE_MS
+    HEAD_FAILED     // timed out or malformed
+  };
+
+  bool resolve(const String& host, IPAddress& ip);
+  bool connect(const String& host, uint16_t port, unsigned long timeoutMs);
+  bool sendRequest(const String& host, uint16_t port, const String& path, const String& headers = "");
+  HeadResult readResponseHead(FrigateResponse& resp, unsigned long timeoutMs);
+
+  AsyncTcpStream _client;
+  bool _connected = false;
+  String _host;
+  uint16_t _port = 0;
+  bool _keepAlive = false;
+  int _pipelineBacklog = 0;
+  unsigned long _pipelineConnectedAt = 0;
+  unsigned long _requestStart = 0;
+  unsigned long _lastConnectAttempt = 0;
+
+  String _dnsHost;
+  IPAddress _dnsIp;
+  unsigned long _dnsAt = 0;
+
+  FrigateConnStats _stats;
+};
+
+extern FrigateConnection frigateConn;
+
+const char* frigateErrorToString(int code);
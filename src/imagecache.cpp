@@ -0,0 +1,113 @@
+#include "imagecache.h"
+#include <SD_MMC.h>
+
+ImageCache imageCache;
+
+void ImageCache::begin(size_t budget) {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+  _budget = psramFound() ? budget : 0;
+  Serial.printf("[CACHE] Image cache budget: %u KB\n", (unsigned)(_budget / 1024));
+}
+
+// ------------------------
+//  LRU bookkeeping
+// ------------------------
+void ImageCache::eraseLocked(std::list<Entry>::iterator it) {
+  _stats.bytes -= it->image->size;
+  _index.erase(it->name);
+  _lru.erase(it);
+  _stats.entries = _lru.size();
+}
+
+void ImageCache::insertLocked(const String& name, CachedImageRef image) {
+  auto existing = _index.find(name);
+  if (existing != _index.end()) eraseLocked(existing->second);
+
+  while (!_lru.empty() && _stats.bytes + image->size > _budget) {
+    eraseLocked(std::prev(_lru.end()));
+    _stats.evictions++;
+  }
+
+  _lru.push_front({name, image});
+  _index[name] = _lru.begin();
+  _stats.bytes += image->size;
+  _stats.entries = _lru.size();
+}
+
+// ------------------------
+//  Public API
+// ------------------------
+void ImageCache::adopt(const String& name, uint8_t* data, size_t size) {
+  CachedImageRef image = std::make_shared<CachedImage>();
+  image->data = data;
+  image->size = size;
+  if (!enabled() || size > _budget) return; // image frees the buffer
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  insertLocked(name, image);
+  xSemaphoreGive(_mutex);
+}
+
+CachedImageRef ImageCache::load(const String& name) {
+  if (enabled()) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    auto it = _index.find(name);
+    if (it != _index.end()) {
+      _lru.splice(_lru.begin(), _lru, it->second);
+      CachedImageRef image = it->second->image;
+      _stats.hits++;
+      xSemaphoreGive(_mutex);
+      return image;
+    }
+    _stats.misses++;
+    xSemaphoreGive(_mutex);
+  }
+
+  File file = SD_MMC.open(name, FILE_READ);
+  if (!file) return nullptr;
+
+  CachedImageRef image = std::make_shared<CachedImage>();
+  image->size = file.size();
+  image->data = (uint8_t*)(enabled() ? ps_malloc(image->size) : malloc(image->size));
+  if (!image->data) {
+    file.close();
+    Serial.println("[CACHE] Memory allocation failed for: " + name);
+    return nullptr;
+  }
+  size_t bytesRead = file.read(image->data, image->size);
+  file.close();
+  if (bytesRead != image->size) return nullptr;
+
+  if (enabled() && image->size <= _budget) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    insertLocked(name, image);
+    xSemaphoreGive(_mutex);
+  }
+  return image;
+}
+
+void ImageCache::remove(const String& name) {
+  if (!enabled()) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  auto it = _index.find(name);
+  if (it != _index.end()) eraseLocked(it->second);
+  xSemaphoreGive(_mutex);
+}
+
+void ImageCache::clear() {
+  if (!enabled()) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _lru.clear();
+  _index.clear();
+  _stats.bytes = 0;
+  _stats.entries = 0;
+  xSemaphoreGive(_mutex);
+}
+
+ImageCacheStats ImageCache::stats() {
+  if (!_mutex) return _stats;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  ImageCacheStats copy = _stats;
+  xSemaphoreGive(_mutex);
+  return copy;
+}
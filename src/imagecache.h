@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Arduino.h>
+#include <list>
+#include <map>
+#include <memory>
+
+// Bytes of PSRAM used for compressed event JPEGs
+const size_t IMAGE_CACHE_BUDGET = 2 * 1024 * 1024;
+
+// A compressed JPEG held in PSRAM. Handed out as a shared_ptr so an entry
+// evicted by the download task stays valid while loop() is still drawing it.
+struct CachedImage {
+  uint8_t* data = nullptr;
+  size_t size = 0;
+  ~CachedImage() { free(data); }
+};
+typedef std::shared_ptr<CachedImage> CachedImageRef;
+
+struct ImageCacheStats {
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+  uint32_t evictions = 0;
+  uint32_t entries = 0;
+  size_t bytes = 0;
+};
+
+// ------------------------
+//  PSRAM LRU image cache
+// ------------------------
+// Keyed by event filename, e.g. "/events/abc123-front.jpg". Thread safe.
+class ImageCache {
+public:
+  void begin(size_t budget = IMAGE_CACHE_BUDGET);
+  bool enabled() const { return _budget > 0; }
+
+  // Takes ownership of a ps_malloc'd buffer holding a complete JPEG
+  void adopt(const String& name, uint8_t* data, size_t size);
+  // Cache hit, or read from SD on a miss and keep it; nullptr when the file is missing
+  CachedImageRef load(const String& name);
+  void remove(const String& name);
+  void clear();
+
+  ImageCacheStats stats();
+  size_t budget() const { return _budget; }
+
+private:
+  struct Entry {
+    String name;
+    CachedImageRef image;
+  };
+
+  void insertLocked(const String& name, CachedImageRef image);
+  void eraseLocked(std::list<Entry>::iterator it);
+
+  std::list<Entry> _lru; // most recently used first
+  std::map<String, std::list<Entry>::iterator> _index;
+  size_t _budget = 0;
+  ImageCacheStats _stats;
+  SemaphoreHandle_t _mutex = nullptr;
+};
+
+extern ImageCache imageCache;
@@ -0,0 +1,152 @@
+#include "jobqueue.h"
+#include "download.h"
+#include "main.h"
+
+JobQueue jobQueue;
+
+void JobQueue::begin() {
+  if (_mutex) return;
+  _mutex = xSemaphoreCreateMutex();
+  _ready = xSemaphoreCreateBinary();
+  _jobs.reserve(JOB_QUEUE_CAPACITY);
+}
+
+uint32_t JobQueue::rankOf(const DownloadJob& job) {
+  bool background = job.backfill || job.speculative || job.refresh;
+  return (background ? 0 : 1UL << 16) | ((uint32_t)job.rank << 8) | (job.display ? 1 : 0);
+}
+
+bool JobQueue::outranks(const DownloadJob& a, const DownloadJob& b) {
+  uint32_t ra = rankOf(a), rb = rankOf(b);
+  if (ra != rb) return ra > rb;
+  return (long)(b.queuedAt - a.queuedAt) > 0; // older first
+}
+
+// True when the job was merged into one already waiting
+bool JobQueue::coalesceLocked(const DownloadJob& job) {
+  for (DownloadJob& queued : _jobs) {
+    if (strcmp(queued.url, job.url) != 0 || strcmp(queued.zone, job.zone) != 0) continue;
+    // The same snapshot twice: keep one with the stronger claim of both
+    bool stronger = rankOf(job) > rankOf(queued);
+    if (stronger) {
+      queued.display = queued.display || job.display;
+      queued.backfill = job.backfill;
+      queued.speculative = job.speculative;
+      queued.refresh = job.refresh;
+      queued.rank = max(queued.rank, job.rank);
+      queued.displaySec = job.displaySec;
+      if (job.trace.active()) queued.trace = job.trace;
+    }
+    if (!queued.jpeg && job.jpeg) {
+      queued.jpeg = job.jpeg;
+      queued.jpegSize = job.jpegSize;
+    } else {
+      free(job.jpeg);
+    }
+    _stats.coalesced++;
+    return true;
+  }
+
+  // One announcement per camera: a newer event from the same camera takes the
+  // screen, the older one still lands in the slideshow
+  if (job.display) {
+    for (DownloadJob& queued : _jobs) {
+      if (queued.display && strcmp(queued.camera, job.camera) == 0 && !outranks(queued, job)) {
+        queued.display = false;
+        _stats.coalesced++;
+      }
+    }
+  }
+  return false;
+}
+
+bool JobQueue::push(const DownloadJob& job) {
+  if (!_mutex) {
+    free(job.jpeg);
+    return false;
+  }
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  bool merged = coalesceLocked(job);
+  bool accepted = true;
+  if (!merged) {
+    if (_jobs.size() >= (size_t)JOB_QUEUE_CAPACITY) {
+      auto lowest = _jobs.begin();
+      for (auto it = _jobs.begin(); it != _jobs.end(); ++it) {
+        if (outranks(*lowest, *it)) lowest = it;
+      }
+      if (outranks(job, *lowest)) {
+        Serial.println("[QUEUE] Full, dropped: " + String(lowest->url));
+        free(lowest->jpeg);
+        _jobs.erase(lowest);
+        _stats.evicted++;
+      } else {
+        accepted = false;
+        _stats.rejected++;
+      }
+    }
+    if (accepted) {
+      _jobs.push_back(job);
+      _stats.queued++;
+    } else {
+      free(job.jpeg);
+    }
+  }
+  _stats.pending = _jobs.size();
+  _stats.highWater = max(_stats.highWater, _stats.pending);
+  xSemaphoreGive(_mutex);
+
+  if (accepted) {
+    int32_t running = _runningRank.load();
+    if (running >= 0 && rankOf(job) > (uint32_t)running && (job.display || !_runningDisplay.load())) {
+      _runningRank.store(-1);
+      _stats.preempted++;
+      cancelDownload();
+    }
+    xSemaphoreGive(_ready);
+  }
+  return accepted;
+}
+
+int JobQueue::take(DownloadJob* jobs, int max, TickType_t wait) {
+  if (!_mutex) return 0;
+  for (int round = 0; round < 2; round++) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    unsigned long now = millis();
+    int count = 0;
+    while (count < max && !_jobs.empty()) {
+      auto best = _jobs.begin();
+      for (auto it = _jobs.begin(); it != _jobs.end(); ++it) {
+        if (outranks(*it, *best)) best = it;
+      }
+      jobs[count] = *best;
+      _jobs.erase(best);
+      // Too late to announce; the image still joins the gallery
+      DownloadJob& job = jobs[count];
+      unsigned long window = (job.displaySec ? job.displaySec : displayDuration) * 1000UL;
+      if (job.display && !job.backfill && now - job.queuedAt > window) {
+        job.display = false;
+        job.backfill = true;
+        _stats.stale++;
+      }
+      count++;
+    }
+    _stats.pending = _jobs.size();
+    xSemaphoreGive(_mutex);
+    if (count > 0 || round == 1) return count;
+    xSemaphoreTake(_ready, wait);
+  }
+  return 0;
+}
+
+void JobQueue::started(const DownloadJob& job) {
+  resetDownloadCancel();
+  // Whoever takes the panel from a half-drawn image draws over it right away
+  _runningDisplay.store(job.display);
+  _runningRank.store((int32_t)rankOf(job));
+}
+
+void JobQueue::finished() {
+  _runningRank.store(-1);
+  // A cancel that lost the race must not abort the next snapshot saved from MQTT
+  resetDownloadCancel();
+}
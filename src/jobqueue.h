@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <vector>
+#include "frigate.h"
+
+// Jobs waiting for the download task; when full the lowest ranked makes room
+const int JOB_QUEUE_CAPACITY = 16;
+
+struct JobQueueStats {
+  uint32_t queued = 0;
+  uint32_t coalesced = 0;   // duplicates merged, or announcements folded per camera
+  uint32_t stale = 0;       // display window over before the download started, kept for the gallery
+  uint32_t evicted = 0;     // pushed out by a higher ranked job
+  uint32_t rejected = 0;    // full of higher ranked jobs
+  uint32_t preempted = 0;   // in-flight downloads cancelled for a higher ranked job
+  size_t pending = 0;
+  size_t highWater = 0;
+};
+
+// ------------------------
+//  Download job queue
+// ------------------------
+// Hands out the most important jobs first: live events over background work
+// (backfill, speculative fetches, refreshes), then the rule priority, alerts
+// over detections, the announcing job of a review over the rest, oldest first.
+// Any task may push; only the download task takes. A push that outranks the
+// job the download task is streaming cancels that download. One being drawn to
+// the panel only gives way to another display job, e.g. an alert over a detection.
+class JobQueue {
+public:
+  void begin();
+
+  // Takes ownership of the job's jpeg, freed when the job is dropped
+  bool push(const DownloadJob& job);
+  // Up to max jobs, best first; waits up to wait when empty
+  int take(DownloadJob* jobs, int max, TickType_t wait);
+
+  // Download task: the job whose body is being read, for preemption
+  void started(const DownloadJob& job);
+  void finished();
+
+  const JobQueueStats& stats() const { return _stats; }
+
+private:
+  static uint32_t rankOf(const DownloadJob& job);
+  static bool outranks(const DownloadJob& a, const DownloadJob& b);
+  bool coalesceLocked(const DownloadJob& job);
+
+  std::vector<DownloadJob> _jobs;
+  SemaphoreHandle_t _mutex = nullptr;
+  SemaphoreHandle_t _ready = nullptr;
+  std::atomic<int32_t> _runningRank{-1};  // -1 when nothing may be preempted
+  std::atomic<bool> _runningDisplay{false};
+  JobQueueStats _stats;
+};
+
+extern JobQueue jobQueue;
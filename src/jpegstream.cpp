@@ -0,0 +1,168 @@
+#include "jpegstream.h"
+#include "main.h" // For tft, lockDisplay
+
+// Bodmer's tjpgd build can byte-swap RGB565 output itself through JDEC::swap;
+// use it when present, otherwise swap in the sink like TJpgDec would.
+template <typename T>
+static auto setDecoderSwap(T& jd, int) -> decltype(jd.swap = 1, true) {
+  jd.swap = 1;
+  return true;
+}
+template <typename T>
+static bool setDecoderSwap(T&, long) {
+  return false;
+}
+static bool decoderSwaps = false;
+
+// ------------------------
+//  Streaming JPEG decoder
+// ------------------------
+JpegStreamDecoder::~JpegStreamDecoder() {
+  free(_workspace);
+}
+
+// tjpgd input callback: buf == nullptr means skip len bytes
+size_t JpegStreamDecoder::input(JDEC* jd, uint8_t* buf, size_t len) {
+  JpegStreamDecoder* self = (JpegStreamDecoder*)jd->device;
+  uint8_t scratch[64];
+  size_t total = 0;
+  while (total < len) {
+    uint8_t* dst = buf ? buf + total : scratch;
+    size_t want = buf ? len - total : min(len - total, sizeof(scratch));
+    int n = self->_source->read(dst, want);
+    if (n <= 0) break; // a short count at the end of the data is fine for tjpgd
+    total += n;
+  }
+  return total;
+}
+
+int JpegStreamDecoder::output(JDEC* jd, void* bitmap, JRECT* rect) {
+  JpegStreamDecoder* self = (JpegStreamDecoder*)jd->device;
+  unsigned long now = millis();
+  if (self->_firstBlockAt == 0) self->_firstBlockAt = now;
+  self->_lastBlockAt = now;
+
+  uint16_t w = rect->right - rect->left + 1;
+  uint16_t h = rect->bottom - rect->top + 1;
+  uint16_t* pixels = (uint16_t*)bitmap;
+  if (!decoderSwaps) {
+    for (uint32_t i = 0, n = (uint32_t)w * h; i < n; i++) pixels[i] = (pixels[i] << 8) | (pixels[i] >> 8);
+  }
+  return self->_sink->drawBlock(rect->left, rect->top, w, h, pixels) ? 1 : 0;
+}
+
+JRESULT JpegStreamDecoder::decode(JpegSource& source, JpegSink& sink, uint8_t scale) {
+  if (!_workspace) {
+    _workspace = (uint8_t*)heap_caps_malloc(JPEG_WORKSPACE_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!_workspace) return JDR_MEM1;
+  }
+  _source = &source;
+  _sink = &sink;
+  _firstBlockAt = 0;
+  _lastBlockAt = 0;
+
+  JDEC jdec = {};
+  decoderSwaps = setDecoderSwap(jdec, 0);
+  JRESULT result = jd_prepare(&jdec, input, _workspace, JPEG_WORKSPACE_SIZE, this);
+  if (result != JDR_OK) return result;
+
+  sink.begin(jdec.width >> scale, jdec.height >> scale);
+  return jd_decomp(&jdec, output, scale);
+}
+
+// ------------------------
+//  Memory source
+// ------------------------
+int MemoryJpegSource::read(uint8_t* buf, size_t len) {
+  size_t n = min(len, _size - _pos);
+  memcpy(buf, _data + _pos, n);
+  _pos += n;
+  return n;
+}
+
+// ------------------------
+//  Panel sink
+// ------------------------
+// The display lock is taken per call, not per image: a download streams for
+// seconds and the panel must not be held for all of it
+void TftJpegSink::begin(uint16_t width, uint16_t height) {
+  int16_t screenW = tft.width();
+  int16_t screenH = tft.height();
+  lockDisplay();
+  // Clear only the margins so there is no black flash over the image area
+  if (width < screenW) tft.fillRect(width, 0, screenW - width, screenH, TFT_BLACK);
+  if (height < screenH) tft.fillRect(0, height, min((int16_t)width, screenW), screenH - height, TFT_BLACK);
+  unlockDisplay();
+}
+
+bool TftJpegSink::drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) {
+  if (y >= tft.height()) return false; // the rest is off screen, stop decoding
+  lockDisplay();
+  tft.pushImage(x, y, w, h, pixels);
+  unlockDisplay();
+  return true;
+}
+
+// ------------------------
+//  Upscaling panel sink
+// ------------------------
+// Locks the display per call, like TftJpegSink
+// An MCU is at most 16x16 pixels
+static uint16_t scaledBlock[(16 * JPEG_MAX_UPSCALE) * (16 * JPEG_MAX_UPSCALE)];
+
+void ScaledTftJpegSink::begin(uint16_t width, uint16_t height) {
+  int16_t screenW = tft.width();
+  int16_t screenH = tft.height();
+  _scale = min((uint32_t)screenW * 256 / max(width, (uint16_t)1), (uint32_t)screenH * 256 / max(height, (uint16_t)1));
+  _scale = constrain(_scale, (uint32_t)256, (uint32_t)JPEG_MAX_UPSCALE * 256);
+
+  int16_t scaledW = min((int16_t)((width * _scale) >> 8), screenW);
+  int16_t scaledH = min((int16_t)((height * _scale) >> 8), screenH);
+  lockDisplay();
+  if (scaledW < screenW) tft.fillRect(scaledW, 0, screenW - scaledW, screenH, TFT_BLACK);
+  if (scaledH < screenH) tft.fillRect(0, scaledH, scaledW, screenH - scaledH, TFT_BLACK);
+  unlockDisplay();
+}
+
+bool ScaledTftJpegSink::drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) {
+  int16_t screenW = tft.width();
+  int16_t screenH = tft.height();
+  int16_t dx0 = (x * _scale) >> 8;
+  int16_t dy0 = (y * _scale) >> 8;
+  if (dy0 >= screenH) return false; // the rest is off screen, stop decoding
+  if (dx0 >= screenW) return true;
+  int16_t dw = min((int16_t)(((x + w) * _scale) >> 8), screenW) - dx0;
+  int16_t dh = min((int16_t)(((y + h) * _scale) >> 8), screenH) - dy0;
+  if (dw <= 0 || dh <= 0) return true;
+
+  for (int16_t row = 0; row < dh; row++) {
+    // Rounding can land a destination pixel just outside its source block
+    int sy = constrain((int)(((dy0 + row) << 8) / _scale) - y, 0, h - 1);
+    for (int16_t col = 0; col < dw; col++) {
+      int sx = constrain((int)(((dx0 + col) << 8) / _scale) - x, 0, w - 1);
+      scaledBlock[row * dw + col] = pixels[sy * w + sx];
+    }
+  }
+  lockDisplay();
+  tft.pushImage(dx0, dy0, dw, dh, scaledBlock);
+  unlockDisplay();
+  return true;
+}
+
+// ------------------------
+//  Frame buffer sink
+// ------------------------
+void FrameJpegSink::begin(uint16_t width, uint16_t height) {
+  if (width < _width || height < _height) memset(_frame, 0, (size_t)_width * _height * sizeof(uint16_t));
+}
+
+bool FrameJpegSink::drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) {
+  if (y >= _height) return false; // the rest is outside the frame, stop decoding
+  if (x >= _width) return true;
+  uint16_t copyW = min((uint16_t)(_width - x), w);
+  uint16_t copyH = min((uint16_t)(_height - y), h);
+  for (uint16_t row = 0; row < copyH; row++) {
+    memcpy(_frame + (size_t)(y + row) * _width + x, pixels + (size_t)row * w, copyW * sizeof(uint16_t));
+  }
+  return true;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <Arduino.h>
+#include <TJpg_Decoder.h>
+
+// Decoder work area; generous enough for every JD_FASTDECODE level of tjpgd
+const size_t JPEG_WORKSPACE_SIZE = 12 * 1024;
+// Largest enlargement ScaledTftJpegSink applies; bounds its block buffer
+const int JPEG_MAX_UPSCALE = 3;
+
+// Supplies compressed bytes; same contract as HttpBodyReader::read()
+class JpegSource {
+public:
+  virtual ~JpegSource() {}
+  virtual int read(uint8_t* buf, size_t len) = 0;
+};
+
+// Reads a JPEG already held in memory, e.g. an image cache entry
+class MemoryJpegSource : public JpegSource {
+public:
+  MemoryJpegSource(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+  int read(uint8_t* buf, size_t len) override;
+
+private:
+  const uint8_t* _data;
+  size_t _size;
+  size_t _pos = 0;
+};
+
+// Receives decoded RGB565 blocks (MCUs) in decode order
+class JpegSink {
+public:
+  virtual ~JpegSink() {}
+  virtual void begin(uint16_t width, uint16_t height) {}
+  virtual bool drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) = 0;
+};
+
+// ------------------------
+//  Streaming JPEG decoder
+// ------------------------
+// Drives tjpgd directly so input can be pulled from a socket as it arrives,
+// instead of TJpgDec which needs the whole file in memory or on a filesystem.
+class JpegStreamDecoder {
+public:
+  ~JpegStreamDecoder();
+  JRESULT decode(JpegSource& source, JpegSink& sink, uint8_t scale = 0);
+
+  unsigned long firstBlockAt() const { return _firstBlockAt; }
+  unsigned long lastBlockAt() const { return _lastBlockAt; }
+
+private:
+  static size_t input(JDEC* jd, uint8_t* buf, size_t len);
+  static int output(JDEC* jd, void* bitmap, JRECT* rect);
+
+  uint8_t* _workspace = nullptr;
+  JpegSource* _source = nullptr;
+  JpegSink* _sink = nullptr;
+  unsigned long _firstBlockAt = 0;
+  unsigned long _lastBlockAt = 0;
+};
+
+// Pushes decoded blocks straight to the panel and blanks what the image does not
+// cover. Takes the display lock per block; see claimPanel() for keeping loop() off.
+class TftJpegSink : public JpegSink {
+public:
+  void begin(uint16_t width, uint16_t height) override;
+  bool drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) override;
+};
+
+// Enlarges a small image to fill the panel (nearest neighbour), e.g. an event
+// thumbnail shown while the full snapshot is still on its way
+class ScaledTftJpegSink : public JpegSink {
+public:
+  void begin(uint16_t width, uint16_t height) override;
+  bool drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) override;
+
+private:
+  uint32_t _scale = 256; // 8.8 fixed point
+};
+
+// Renders into an off-screen RGB565 frame in panel byte order, black where the image does not reach
+class FrameJpegSink : public JpegSink {
+public:
+  FrameJpegSink(uint16_t* frame, uint16_t width, uint16_t height) : _frame(frame), _width(width), _height(height) {}
+  void begin(uint16_t width, uint16_t height) override;
+  bool drawBlock(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t* pixels) override;
+
+private:
+  uint16_t* _frame;
+  uint16_t _width;
+  uint16_t _height;
+};
@@ -0,0 +1,102 @@
+#include "latency.h"
+
+LatencyTracer latencyTracer;
+
+// ------------------------
+//  Histogram
+// ------------------------
+int LatencyHistogram::bucketOf(unsigned long ms) {
+  if (ms < 16) return ms;
+  if (ms > LATENCY_MAX_MS) ms = LATENCY_MAX_MS;
+  int exponent = 31 - __builtin_clz(ms);   // 4..15
+  return 16 + (exponent - 4) * 8 + ((ms >> (exponent - 3)) & 7);
+}
+
+unsigned long LatencyHistogram::bucketUpper(int bucket) {
+  if (bucket < 16) return bucket;
+  int exponent = 4 + (bucket - 16) / 8;
+  unsigned long width = 1UL << (exponent - 3);
+  return (1UL << exponent) + ((bucket - 16) % 8 + 1) * width - 1;
+}
+
+void LatencyHistogram::record(unsigned long ms) {
+  _buckets[bucketOf(ms)]++;
+  _count++;
+  if (ms > _max) _max = ms;
+}
+
+unsigned long LatencyHistogram::percentile(float p) const {
+  if (_count == 0) return 0;
+  uint32_t rank = (uint32_t)ceilf(p * _count);
+  if (rank < 1) rank = 1;
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += _buckets[i];
+    if (seen >= rank) return min(bucketUpper(i), _max);
+  }
+  return _max;
+}
+
+// ------------------------
+//  Tracer
+// ------------------------
+void LatencyTracer::begin() {
+  if (!_mutex) _mutex = xSemaphoreCreateMutex();
+}
+
+void LatencyTracer::finish(const char* filename, const EventTrace& trace) {
+  if (!_mutex || !trace.active()) return;
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  unsigned long start = trace.at[STAGE_MQTT];
+  for (int s = STAGE_URL; s < LATENCY_STAGES; s++) {
+    if (trace.at[s] != 0) _stages[s].record(trace.at[s] - start);
+  }
+  TraceRecord& record = _history[_next];
+  strlcpy(record.filename, filename, sizeof(record.filename));
+  record.trace = trace;
+  _next = (_next + 1) % LATENCY_TRACE_HISTORY;
+  if (_stored < LATENCY_TRACE_HISTORY) _stored++;
+  _events++;
+  xSemaphoreGive(_mutex);
+
+  if (trace.at[STAGE_LAST_MCU] != 0) {
+    Serial.printf("[LATENCY] %s on glass %lu ms after MQTT (%s)\n", filename,
+                  trace.at[STAGE_LAST_MCU] - start, trace.tee ? "tee" : "SD");
+  }
+}
+
+LatencyHistogram LatencyTracer::histogram(LatencyStage stage) {
+  LatencyHistogram copy;
+  if (!_mutex) return copy;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  copy = _stages[stage];
+  xSemaphoreGive(_mutex);
+  return copy;
+}
+
+std::vector<TraceRecord> LatencyTracer::traces() {
+  std::vector<TraceRecord> copy;
+  if (!_mutex) return copy;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  copy.reserve(_stored);
+  int first = (_next - _stored + LATENCY_TRACE_HISTORY) % LATENCY_TRACE_HISTORY;
+  for (int i = 0; i < _stored; i++) copy.push_back(_history[(first + i) % LATENCY_TRACE_HISTORY]);
+  xSemaphoreGive(_mutex);
+  return copy;
+}
+
+const char* latencyStageToString(LatencyStage stage) {
+  switch (stage) {
+    case STAGE_MQTT: return "mqtt";
+    case STAGE_URL: return "url";
+    case STAGE_CONNECT: return "connect";
+    case STAGE_FIRST_BYTE: return "firstByte";
+    case STAGE_LAST_BYTE: return "lastByte";
+    case STAGE_SAVED: return "saved";
+    case STAGE_DECODE_START: return "decodeStart";
+    case STAGE_LAST_MCU: return "lastMcu";
+    default: break;
+  }
+  return "unknown";
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Points an event passes on its way from MQTT to the panel
+enum LatencyStage {
+  STAGE_MQTT,          // MQTT message callback entered
+  STAGE_URL,           // snapshot URL built, job queued
+  STAGE_CONNECT,       // socket ready, request about to be written
+  STAGE_FIRST_BYTE,    // response head arriving
+  STAGE_LAST_BYTE,     // body fully read
+  STAGE_SAVED,         // file renamed into /events
+  STAGE_DECODE_START,
+  STAGE_LAST_MCU,      // last block pushed to the TFT
+  LATENCY_STAGES
+};
+
+// Log-linear buckets: exact below 16 ms, then 8 per power of two (<= 12.5% wide) up to 65 s
+const int LATENCY_BUCKETS = 112;
+const unsigned long LATENCY_MAX_MS = 65535;
+// Per-event traces kept for /latency/traces
+const int LATENCY_TRACE_HISTORY = 50;
+
+// Stage timestamps of one event. Travels by value with its download job and
+// result; trivially copyable so it can sit in FreeRTOS queues.
+struct EventTrace {
+  unsigned long at[LATENCY_STAGES];   // millis(), 0 = stage not reached
+  uint8_t attempts;
+  bool tee;                           // drawn while streaming, not from SD
+
+  // A zero time means the source never saw the stage and is ignored
+  void stamp(LatencyStage stage, unsigned long when) { if (when) at[stage] = when; }
+  void stamp(LatencyStage stage) { stamp(stage, millis()); }
+  bool active() const { return at[STAGE_MQTT] != 0; }
+};
+
+struct TraceRecord {
+  char filename[32];
+  EventTrace trace;
+};
+
+class LatencyHistogram {
+public:
+  void record(unsigned long ms);
+  // Upper edge of the bucket holding the p-th fraction of samples, e.g. 0.95
+  unsigned long percentile(float p) const;
+  uint32_t count() const { return _count; }
+  unsigned long maxMs() const { return _max; }
+
+private:
+  static int bucketOf(unsigned long ms);
+  static unsigned long bucketUpper(int bucket);
+
+  uint32_t _buckets[LATENCY_BUCKETS] = {};
+  uint32_t _count = 0;
+  unsigned long _max = 0;
+};
+
+// ------------------------
+//  Event latency tracer
+// ------------------------
+// Keeps one histogram per stage of the time since MQTT receipt, plus a ring of
+// the last LATENCY_TRACE_HISTORY traces. finish() is called from loop() once an
+// event's image is on the panel; readers on the web server take copies.
+class LatencyTracer {
+public:
+  void begin();
+  void finish(const char* filename, const EventTrace& trace);
+
+  LatencyHistogram histogram(LatencyStage stage);
+  // Oldest first
+  std::vector<TraceRecord> traces();
+  uint32_t events() const { return _events; }
+
+private:
+  SemaphoreHandle_t _mutex = nullptr;
+  LatencyHistogram _stages[LATENCY_STAGES];
+  TraceRecord _history[LATENCY_TRACE_HISTORY];
+  int _next = 0;
+  int _stored = 0;
+  uint32_t _events = 0;
+};
+
+extern LatencyTracer latencyTracer;
+
+const char* latencyStageToString(LatencyStage stage);
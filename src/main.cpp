@@ -7,7 +7,6 @@
 #include <AsyncMqttClient.h>
 #include <TJpg_Decoder.h>
 #include <Preferences.h>
-#include <HTTPClient.h>
 #include <FS.h>
 #include <SD_MMC.h>
 #include <SPIFFS.h>
@@ -16,9 +15,22 @@
 #include <Update.h>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 
 #include "frigate.h"
+#include "eventindex.h"
+#include "filterrules.h"
+#include "frigateconn.h"
+#include "imagecache.h"
+#include "jobqueue.h"
+#include "latency.h"
 #include "mqtt.h"
+#include "mqttsnapshots.h"
+#include "objectevents.h"
+#include "prefetch.h"
+#include "quality.h"
+#include "retention.h"
+#include "reviews.h"
 #include "weather.h"
 
 //
@@ -35,12 +47,9 @@
 Preferences preferences;
 
 // Constants
-const char* CLIENT_ID = "ESP32Client";
 const char* DEFAULT_SSID = "ESP32_AP";
 const char* DEFAULT_PASSWORD = "admin1234";
 const unsigned long WIFI_TIMEOUT = 10000;
-const unsigned long MQTT_RECONNECT_INTERVAL = 5000;
-const unsigned long FRIGATE_KEEPALIVE_INTERVAL = 25UL * 1000UL; // 25 seconds
 
 // Clock consts
 const unsigned long CLOCK_REFRESH_INTERVAL = 1000UL; // 1 second
@@ -53,12 +62,14 @@ String mode = "alert"; // Default to "alert"
 String currentScreen = "clock"; // ["clock", "event", "status", "error"]
 TFT_eSPI tft = TFT_eSPI();
 AsyncWebServer server(80);
-HTTPClient http;
 
 bool restartPending = false;// used to receive requests from /reboot HTTP endpoint
 
 int displayDuration = 30;
 int maxImages = 30;
+int maxStorageMB = 0;        // 0 = no limit
+int maxAgeHours = 0;         // 0 = no limit
+int maxImagesPerCamera = 0;  // 0 = no limit
 unsigned long lastClockUpdate = 0;
 unsigned long lastKeyTime = 0;
 unsigned long screenTimeout = 0;
@@ -79,7 +90,36 @@ unsigned long lastEventCall = 0;
 // ------------------------
 //  Forward Declarations
 // ------------------------
-void setScreen(const String& newScreen, unsigned long timeoutSec = 0, const char* by = "");
+void setScreen(const String& newScreen, unsigned long timeoutSec = 0, const char* by = "", bool redraw = true);
+bool lockDisplay(TickType_t wait = portMAX_DELAY);
+
+// ------------------------
+//  Display lock
+// ------------------------
+static SemaphoreHandle_t displayMutex = nullptr;
+
+bool lockDisplay(TickType_t wait) {
+  if (!displayMutex) return true;
+  return xSemaphoreTakeRecursive(displayMutex, wait) == pdTRUE;
+}
+
+void unlockDisplay() {
+  if (displayMutex) xSemaphoreGiveRecursive(displayMutex);
+}
+
+static std::atomic<bool> panelClaim{false};
+
+void claimPanel() {
+  panelClaim = true;
+}
+
+void releasePanel() {
+  panelClaim = false;
+}
+
+bool panelClaimed() {
+  return panelClaim;
+}
 
 // ------------------------
 //  JPEG render callback
@@ -89,6 +129,29 @@ bool jpgRenderCallback(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t *b
   return true;
 }
 
+// ------------------------
+//  Event image from the PSRAM cache, SD on a miss
+// ------------------------
+bool drawEventImage(const String& filename) {
+  if (!eventIndex.contains(filename)) return false;
+  CachedImageRef image = imageCache.load(filename);
+  if (!image) return false;
+  // Blank only what the image will not cover, so the old slide does not flash to black
+  uint16_t w = 0, h = 0;
+  TJpgDec.getJpgSize(&w, &h, image->data, image->size);
+  if (w < tft.width()) tft.fillRect(w, 0, tft.width() - w, tft.height(), TFT_BLACK);
+  if (h < tft.height()) tft.fillRect(0, h, min((int16_t)w, tft.width()), tft.height() - h, TFT_BLACK);
+  TJpgDec.drawJpg(0, 0, image->data, image->size);
+  return true;
+}
+
+// A refreshed snapshot replaces the single event image in place; a running
+// slideshow picks it up on its next turn
+void redrawEventImage(const String& filename) {
+  if (currentScreen != "event" || slideshowActive || jpgQueue.empty() || jpgQueue.back() != filename) return;
+  if (drawEventImage(filename)) Serial.println("[DEBUG] Redrew refreshed image: " + filename);
+}
+
 // ------------------------
 //  Slideshow handler
 // ------------------------
@@ -114,39 +177,39 @@ void handleSlideshow() {
   // Check if it's time for the next image
   if (now - slideshowStart >= currentSlideshowIdx * slideshowInterval) {
     String filename = jpgQueue[currentSlideshowIdx % jpgQueue.size()];
-    if (SD_MMC.exists(filename)) {
-      File file = SD_MMC.open(filename, FILE_READ);
-      if (file) {
-        uint32_t fileSize = file.size();
-        uint8_t* jpgData = (uint8_t*)malloc(fileSize);
-        if (jpgData) {
-          size_t bytesRead = file.readBytes((char*)jpgData, fileSize);
-          file.close();
-          if (bytesRead == fileSize) {
-            tft.fillScreen(TFT_BLACK);
-            TJpgDec.drawJpg(0, 0, jpgData, fileSize);
-            Serial.println("[SLIDESHOW] Displayed: " + filename);
-          }
-          free(jpgData);
-        } else {
-          file.close(); // Ensure file is closed even if malloc fails
-          Serial.println("[SLIDESHOW] Memory allocation failed for: " + filename);
-        }
-      } else {
-        Serial.println("[SLIDESHOW] Cannot open file: " + filename);
-      }
+    unsigned long frameStart = millis();
+    bool prefetched = framePrefetch.show(filename);
+    if (prefetched || drawEventImage(filename)) {
+      framePrefetch.recordFrameTime(millis() - frameStart, prefetched);
+      Serial.println("[SLIDESHOW] Displayed: " + filename + (prefetched ? " (prefetched)" : ""));
     } else {
       Serial.println("[SLIDESHOW] Image not found: " + filename);
     }
 
     currentSlideshowIdx++;
+
+    // Decode the next slides on the other core while this one is on screen
+    for (int ahead = 0; ahead < framePrefetch.depth(); ahead++) {
+      framePrefetch.request(jpgQueue[(currentSlideshowIdx + ahead) % jpgQueue.size()]);
+    }
+  }
+}
+
+// Older events from the card follow the live ones; files retention has
+// deleted since are dropped from galleryQueue on the way
+static void appendGallery() {
+  galleryQueue.erase(std::remove_if(galleryQueue.begin(), galleryQueue.end(),
+                                    [](const String& f) { return !eventIndex.contains(f); }),
+                     galleryQueue.end());
+  for (const String& filename : galleryQueue) {
+    if (std::find(jpgQueue.begin(), jpgQueue.end(), filename) == jpgQueue.end()) jpgQueue.push_back(filename);
   }
 }
 
 // ------------------------
 //  STATE-based screen management
 // ------------------------
-void setScreen(const String& newScreen, unsigned long timeoutSec, const char* by) {
+void setScreen(const String& newScreen, unsigned long timeoutSec, const char* by, bool redraw) {
   Serial.printf("setScreen: from %s to %s (timeout: %lu sec) by: %s\n", currentScreen.c_str(), newScreen.c_str(), timeoutSec, by);
 
   // Remove old event calls outside displayDuration
@@ -169,35 +232,17 @@ void setScreen(const String& newScreen, unsigned long timeoutSec, const char* by
       slideshowActive = true;
       slideshowStart = now;
       currentSlideshowIdx = 0;
+      appendGallery();
     }
 
     // If slideshow is active, delegate to handleSlideshow
     if (slideshowActive && !jpgQueue.empty()) {
       handleSlideshow();
-    } else if (!slideshowActive && !jpgQueue.empty()) {
-      // Display single image
-      String filename = jpgQueue[0];
-      if (SD_MMC.exists(filename)) {
-        File file = SD_MMC.open(filename, FILE_READ);
-        if (file) {
-          uint32_t fileSize = file.size();
-          uint8_t* jpgData = (uint8_t*)malloc(fileSize);
-          if (jpgData) {
-            size_t bytesRead = file.readBytes((char*)jpgData, fileSize);
-            file.close();
-            if (bytesRead == fileSize) {
-              tft.fillScreen(TFT_BLACK);
-              TJpgDec.drawJpg(0, 0, jpgData, fileSize);
-              Serial.println("[DEBUG] Displayed single image: " + filename);
-            }
-            free(jpgData);
-          } else {
-            file.close(); // Ensure file is closed even if malloc fails
-            Serial.println("[DEBUG] Memory allocation failed for: " + filename);
-          }
-        } else {
-          Serial.println("[DEBUG] Cannot open file: " + filename);
-        }
+    } else if (!slideshowActive && !jpgQueue.empty() && redraw) {
+      // Display single image: the newest event
+      String filename = jpgQueue.back();
+      if (drawEventImage(filename)) {
+        Serial.println("[DEBUG] Displayed single image: " + filename);
       } else {
         Serial.println("[DEBUG] Image not found: " + filename);
       }
@@ -226,6 +271,14 @@ void setScreen(const String& newScreen, unsigned long timeoutSec, const char* by
   screenSince = now;
 }
 
+// A preview is already on the panel; the event itself is counted once its image lands
+void holdEventScreen(unsigned long timeoutSec, const char* by) {
+  Serial.printf("holdEventScreen: from %s (timeout: %lu sec) by: %s\n", currentScreen.c_str(), timeoutSec, by);
+  currentScreen = "event";
+  screenTimeout = (timeoutSec == 0) ? 0 : timeoutSec * 1000UL;
+  screenSince = millis();
+}
+
 // ------------------------
 //  Clock display
 // ------------------------
@@ -376,9 +429,13 @@ struct Config {
   int fport;
   int sec;
   String mode;
+  String rules;
   String weatherApiKey;
   String weatherCity;
   int maxImages;
+  int maxStorageMB;
+  int maxAgeHours;
+  int maxPerCamera;
   int timezone;
 };
 
@@ -395,9 +452,13 @@ Config getConfig() {
   config.fport = preferences.getInt("fport", 5000);
   config.sec = preferences.getInt("sec", 30);
   config.mode = preferences.getString("mode", "alert");
+  config.rules = preferences.getString("rules", "");
   config.weatherApiKey = preferences.getString("weatherApiKey", "");
   config.weatherCity = preferences.getString("weatherCity", "");
   config.maxImages = preferences.getInt("maxImages", 10);
+  config.maxStorageMB = preferences.getInt("maxStorageMB", 0);
+  config.maxAgeHours = preferences.getInt("maxAgeHours", 0);
+  config.maxPerCamera = preferences.getInt("maxPerCamera", 0);
   config.timezone = preferences.getInt("timezone", 0);
   preferences.end();
   return config;
@@ -417,52 +478,16 @@ String formatTimestamp(unsigned long mtime) {
 // ------------------------
 String getImagesList() {
   String html = "<ul class='image-list'>";
-  File root = SD_MMC.open("/events");
-  
-  if (!root || !root.isDirectory()) {
-    if (root) root.close(); // Close if opened but not directory
-    html += "<li>Could not open SD_MMC</li>";
-    html += "</ul>";
-    return html;
-  }
-
-  struct FileInfo {
-    String name;
-    String displayName;
-    unsigned long size;
-    unsigned long mtime;
-  };
-  std::vector<FileInfo> files;
-
-  File file = root.openNextFile();
-  while (file) {
-    String fname = file.name();
-    if (fname.endsWith(".jpg")) {
-      String displayName = fname;
-      if (!fname.startsWith("/")) {
-        fname = "/events/" + fname;
-      }
-      FileInfo info;
-      info.name = fname;
-      info.displayName = displayName;
-      info.size = (unsigned long)file.size();
-      info.mtime = file.getLastWrite();
-      files.push_back(info);
-    }
-    file.close();
-    file = root.openNextFile();
-  }
-  root.close();
-
-  std::sort(files.begin(), files.end(), [](const FileInfo& a, const FileInfo& b) {
-    return a.mtime > b.mtime;
-  });
+  std::vector<EventFile> files = eventIndex.snapshot();
 
-  for (const FileInfo& info : files) {
+  // Newest first
+  for (auto it = files.rbegin(); it != files.rend(); ++it) {
+    const EventFile& info = *it;
+    String displayName = info.name.substring(info.name.lastIndexOf('/') + 1);
     html += "<li>";
     html += "<img src='" + info.name + "' alt='Event image'>";
-    html += "<a href='" + info.name + "'>" + info.displayName + "</a>";
-    html += "<span>" + String(info.size) + " bytes</span>";
+    html += "<a href='" + info.name + "'>" + displayName + "</a>";
+    html += "<span>" + String((unsigned long)info.size) + " bytes</span>";
     html += " <span>" + formatTimestamp(info.mtime) + "</span></li>";
   }
 
@@ -520,9 +545,17 @@ void setupWebInterface() {
     html.replace("{{fport}}", String(config.fport));
     html.replace("{{sec}}", String(config.sec));
     html.replace("{{maxImages}}", String(config.maxImages));
+    html.replace("{{maxStorageMB}}", String(config.maxStorageMB));
+    html.replace("{{maxAgeHours}}", String(config.maxAgeHours));
+    html.replace("{{maxPerCamera}}", String(config.maxPerCamera));
     html.replace("{{slideshowInterval}}", String(slideshowInterval));
+    html.replace("{{prefetchDepth}}", String(framePrefetch.depth()));
     html.replace("{{alertCheckbox}}", alertCheckbox);
     html.replace("{{detectionCheckbox}}", detectionCheckbox);
+    String rulesHtml = config.rules;
+    rulesHtml.replace("&", "&amp;");
+    rulesHtml.replace("<", "&lt;");
+    html.replace("{{rules}}", rulesHtml);
     html.replace("{{weatherApiKey}}", config.weatherApiKey != "" ? "******" : "");
     html.replace("{{weatherApiKey_exists}}", config.weatherApiKey != "" ? "1" : "0");
     html.replace("{{weatherCity}}", config.weatherCity);
@@ -596,12 +629,34 @@ void setupWebInterface() {
     if (newMaxImages > 60) newMaxImages = 60;
     preferences.putInt("maxImages", newMaxImages);
     maxImages = newMaxImages;
+
+    int newMaxStorageMB = getIntParam(request, "maxStorageMB", 0);
+    if (newMaxStorageMB < 0) newMaxStorageMB = 0;
+    preferences.putInt("maxStorageMB", newMaxStorageMB);
+    maxStorageMB = newMaxStorageMB;
+
+    int newMaxAgeHours = getIntParam(request, "maxAgeHours", 0);
+    if (newMaxAgeHours < 0) newMaxAgeHours = 0;
+    preferences.putInt("maxAgeHours", newMaxAgeHours);
+    maxAgeHours = newMaxAgeHours;
+
+    int newMaxPerCamera = getIntParam(request, "maxPerCamera", 0);
+    if (newMaxPerCamera < 0) newMaxPerCamera = 0;
+    preferences.putInt("maxPerCamera", newMaxPerCamera);
+    maxImagesPerCamera = newMaxPerCamera;
+    requestRetentionSweep();
   
     int newSlideshowInterval = getIntParam(request, "slideshowInterval", 0);
     if (newSlideshowInterval < 500) newSlideshowInterval = 3000;
     if (newSlideshowInterval > 20000) newSlideshowInterval = 20000;
     slideshowInterval = newSlideshowInterval;
     preferences.putInt("slideInterval", slideshowInterval);
+
+    int newPrefetchDepth = getIntParam(request, "prefetchDepth", PREFETCH_DEFAULT_DEPTH);
+    if (newPrefetchDepth < 0) newPrefetchDepth = 0;
+    if (newPrefetchDepth > PREFETCH_MAX_DEPTH) newPrefetchDepth = PREFETCH_MAX_DEPTH;
+    preferences.putInt("prefetch", newPrefetchDepth);
+    if (newPrefetchDepth != framePrefetch.depth()) framePrefetch.setDepth(newPrefetchDepth);
   
     // Modes
     String modeValue = "";
@@ -618,6 +673,13 @@ void setupWebInterface() {
     }
     preferences.putString("mode", modeValue);
     mode = modeValue;
+
+    // Filter rules; without any the mode checkboxes decide
+    String rulesValue = request->hasParam("rules", true) ? request->getParam("rules", true)->value() : "";
+    rulesValue.replace("\r", "");
+    rulesValue.trim();
+    preferences.putString("rules", rulesValue);
+    filterRules.compile(rulesValue.length() > 0 ? rulesValue : FilterRules::fromMode(mode));
   
     // Weather
     String newApiKey = request->getParam("weatherApiKey", true)->value();
@@ -641,12 +703,7 @@ void setupWebInterface() {
     mqttPass = newMqttPass;
     frigatePort = newFport;
   
-    if (mqttConfigChanged) {
-      if (mqttClient.connected()) mqttClient.disconnect();
-      mqttClient.setServer(mqttServer.c_str(), mqttPort);
-      mqttClient.setCredentials(mqttUser.c_str(), mqttPass.c_str());
-      mqttClient.connect();
-    }
+    if (mqttConfigChanged) restartMqtt();
 
     String cacheBuster = "/?v=" + String(millis());
     request->redirect(cacheBuster);
@@ -686,27 +743,14 @@ void setupWebInterface() {
 
   server.on("/delete_all", HTTP_POST, [](AsyncWebServerRequest *request) {
     int deleted = 0;
-    File root = SD_MMC.open("/events");
-    if (!root || !root.isDirectory()) {
-      if (root) root.close(); // Close if opened but not directory
-      request->send(500, "text/plain", "Could not open /events");
-      return;
-    }
-    File file = root.openNextFile();
-    while (file) {
-      String fname = file.name();
-      if (fname.endsWith(".jpg")) {
-        if (!fname.startsWith("/")) {
-          fname = "/events/" + fname;
-        }
-        if (SD_MMC.exists(fname) && SD_MMC.remove(fname)) {
-          // remove() automatically closes the file
-          deleted++;
-        }
+    for (const EventFile& info : eventIndex.snapshot()) {
+      if (SD_MMC.remove(info.name)) {
+        deleted++;
       }
-      file = root.openNextFile();
+      eventIndex.remove(info.name);
     }
-    root.close();
+    imageCache.clear();
+    framePrefetch.clear();
     String response = "Deleted: " + String(deleted) + " images";
     request->send(200, "text/plain", response);
     String cacheBuster = "/?v=" + String(millis());
@@ -716,9 +760,12 @@ void setupWebInterface() {
   server.on("/show_image", HTTP_GET, [](AsyncWebServerRequest *request) {
     if (request->hasParam("url")) {
       String url = request->getParam("url")->value();
-      pendingImageUrl = url;
-      imagePending = true;
-      request->send(200, "text/plain", "Image will be shown on display!");
+      String zone = request->hasParam("zone") ? request->getParam("zone")->value() : String("manual");
+      if (queueSnapshotDownload(url, "", zone)) {
+        request->send(200, "text/plain", "Image will be shown on display!");
+      } else {
+        request->send(503, "text/plain", "Download queue full");
+      }
     } else {
       request->send(400, "text/plain", "Missing url parameter");
     }
@@ -737,6 +784,184 @@ void setupWebInterface() {
     doc["memory"]["psram"]["usedPsramSizeKB"] = (ESP.getPsramSize() - ESP.getFreePsram()) / 1024;
     doc["memory"]["psram"]["minFreePsramKB"] = ESP.getMinFreePsram() / 1024;
     doc["memory"]["psram"]["maxAllocPsramKB"] = ESP.getMaxAllocPsram() / 1024;
+    const FrigateConnStats& frigateStats = frigateConn.stats();
+    doc["frigate"]["connected"] = frigateConn.connected();
+    doc["frigate"]["requests"] = frigateStats.requests;
+    doc["frigate"]["reusedRequests"] = frigateStats.reusedRequests;
+    doc["frigate"]["connects"] = frigateStats.connects;
+    doc["frigate"]["connectFailures"] = frigateStats.connectFailures;
+    doc["frigate"]["dnsLookups"] = frigateStats.dnsLookups;
+    doc["frigate"]["lastDnsMs"] = frigateStats.lastDnsMs;
+    doc["frigate"]["lastConnectMs"] = frigateStats.lastConnectMs;
+    doc["frigate"]["lastTtfbMs"] = frigateStats.lastTtfbMs;
+    doc["frigate"]["lastTotalMs"] = frigateStats.lastTotalMs;
+    const QualityStats& qualityStats = snapshotQuality.stats();
+    doc["frigate"]["quality"] = qualityStats.quality;
+    doc["frigate"]["throughputKBps"] = qualityStats.throughputKBps;
+    doc["frigate"]["avgTtfbMs"] = qualityStats.ttfbMs;
+    doc["frigate"]["predictedMs"] = qualityStats.predictedMs;
+    doc["frigate"]["latencyBudgetMs"] = SNAPSHOT_LATENCY_BUDGET_MS;
+    doc["frigate"]["qualityStepDowns"] = qualityStats.stepDowns;
+    doc["frigate"]["qualityStepUps"] = qualityStats.stepUps;
+    const BreakerStats& breakerStats = frigateBreaker.stats();
+    doc["frigate"]["breaker"] = breakerStateToString(frigateBreaker.state());
+    doc["frigate"]["reachable"] = !frigateBreaker.isOpen();
+    doc["frigate"]["consecutiveFailures"] = breakerStats.consecutiveFailures;
+    doc["frigate"]["failures"] = breakerStats.failures;
+    doc["frigate"]["outages"] = breakerStats.trips;
+    doc["frigate"]["probes"] = breakerStats.probes;
+    if (breakerStats.openedAt != 0) doc["frigate"]["outageSec"] = (millis() - breakerStats.openedAt) / 1000;
+    doc["frigate"]["lastOutageSec"] = breakerStats.lastOutageMs / 1000;
+    doc["frigate"]["retriesPending"] = frigateRetryStats.pending;
+    doc["frigate"]["retriesScheduled"] = frigateRetryStats.scheduled;
+    doc["frigate"]["retriesExhausted"] = frigateRetryStats.exhausted;
+    doc["frigate"]["retriesExpired"] = frigateRetryStats.expired;
+    doc["frigate"]["retriesDropped"] = frigateRetryStats.dropped;
+    doc["display"]["teeEvents"] = displayLatency.teeEvents;
+    doc["display"]["teeFirstPixelMs"] = displayLatency.teeFirstPixelMs;
+    doc["display"]["teeFullFrameMs"] = displayLatency.teeFullFrameMs;
+    if (displayLatency.teeEvents > 0) {
+      doc["display"]["teeFirstPixelAvgMs"] = displayLatency.teeFirstPixelTotalMs / displayLatency.teeEvents;
+      doc["display"]["teeFullFrameAvgMs"] = displayLatency.teeFullFrameTotalMs / displayLatency.teeEvents;
+    }
+    doc["display"]["thumbEvents"] = displayLatency.thumbEvents;
+    doc["display"]["thumbFirstGlanceMs"] = displayLatency.thumbFirstGlanceMs;
+    if (displayLatency.thumbEvents > 0) {
+      doc["display"]["thumbFirstGlanceAvgMs"] = displayLatency.thumbFirstGlanceTotalMs / displayLatency.thumbEvents;
+    }
+    doc["display"]["sdEvents"] = displayLatency.sdEvents;
+    doc["display"]["sdFullFrameMs"] = displayLatency.sdFullFrameMs;
+    if (displayLatency.sdEvents > 0) {
+      doc["display"]["sdFullFrameAvgMs"] = displayLatency.sdFullFrameTotalMs / displayLatency.sdEvents;
+    }
+    const ReviewStats& reviewStats = reviewTracker.stats();
+    doc["reviews"]["active"] = reviewStats.active;
+    doc["reviews"]["messages"] = reviewStats.messages;
+    doc["reviews"]["idle"] = reviewStats.idle;
+    doc["reviews"]["started"] = reviewStats.started;
+    doc["reviews"]["ended"] = reviewStats.ended;
+    doc["reviews"]["evicted"] = reviewStats.evicted;
+    doc["reviews"]["severityChanges"] = reviewStats.severityChanges;
+    doc["reviews"]["historic"] = reviewStats.historic;
+    static const char* const linkStates[] = {"idle", "connecting", "connected", "backoff"};
+    doc["mqtt"]["state"] = linkStates[mqttLinkState.load()];
+    doc["mqtt"]["attempts"] = mqttLinkStats.attempts;
+    doc["mqtt"]["connects"] = mqttLinkStats.connects;
+    doc["mqtt"]["sessionsResumed"] = mqttLinkStats.resumed;
+    doc["mqtt"]["disconnects"] = mqttLinkStats.disconnects;
+    doc["mqtt"]["connectTimeouts"] = mqttLinkStats.timeouts;
+    doc["mqtt"]["lastDisconnectReason"] = mqttLinkStats.lastReason;
+    doc["mqtt"]["retryDelayMs"] = mqttLinkStats.retryDelayMs;
+    doc["mqtt"]["lastOutageMs"] = mqttLinkStats.lastOutageMs;
+    doc["mqtt"]["messages"] = mqttParseStats.messages;
+    doc["mqtt"]["parseErrors"] = mqttParseStats.errors;
+    doc["mqtt"]["payloadKB"] = mqttParseStats.payloadBytes / 1024;
+    doc["mqtt"]["lastParseUs"] = mqttParseStats.lastParseUs;
+    doc["mqtt"]["maxParseUs"] = mqttParseStats.maxParseUs;
+    if (mqttParseStats.messages > 0) {
+      doc["mqtt"]["avgParseUs"] = mqttParseStats.totalParseUs / mqttParseStats.messages;
+    }
+    const MqttAssemblyStats& assembly = mqttAssembler.stats();
+    doc["mqtt"]["fragmented"] = assembly.fragmented;
+    doc["mqtt"]["oversized"] = assembly.oversized;
+    doc["mqtt"]["fragmentTimeouts"] = assembly.timedOut;
+    doc["mqtt"]["fragmentDrops"] = assembly.dropped;
+    doc["mqtt"]["largestPayload"] = assembly.largest;
+    doc["mqtt"]["snapshotsReceived"] = mqttSnapshots.stats().received;
+    doc["mqtt"]["snapshotsMatched"] = mqttSnapshots.stats().matched;
+    doc["mqtt"]["snapshotsMissed"] = mqttSnapshots.stats().missed;
+    doc["mqtt"]["snapshotsReplaced"] = mqttSnapshots.stats().replaced;
+    doc["filter"]["rules"] = filterRules.stats().rules;
+    doc["filter"]["evaluated"] = filterRules.stats().evaluated;
+    doc["filter"]["shown"] = filterRules.stats().shown;
+    doc["filter"]["ignored"] = filterRules.stats().ignored;
+    doc["filter"]["unmatched"] = filterRules.stats().unmatched;
+    doc["objectEvents"]["messages"] = objectEvents.stats().messages;
+    doc["objectEvents"]["ready"] = objectEvents.stats().ready;
+    doc["objectEvents"]["speculative"] = objectEvents.stats().speculative;
+    doc["objectEvents"]["filtered"] = objectEvents.stats().filtered;
+    doc["objectEvents"]["deferred"] = objectEvents.stats().deferred;
+    doc["objectEvents"]["released"] = objectEvents.stats().released;
+    doc["objectEvents"]["improved"] = objectEvents.stats().improved;
+    doc["events"]["count"] = eventIndex.count();
+    doc["events"]["bytesKB"] = eventIndex.totalBytes() / 1024;
+    doc["backfill"]["done"] = backfillStats.done;
+    doc["backfill"]["reviews"] = backfillStats.reviews;
+    doc["backfill"]["existing"] = backfillStats.existing;
+    doc["backfill"]["queued"] = backfillStats.queued;
+    doc["queue"]["pending"] = jobQueue.stats().pending;
+    doc["queue"]["highWater"] = jobQueue.stats().highWater;
+    doc["queue"]["queued"] = jobQueue.stats().queued;
+    doc["queue"]["coalesced"] = jobQueue.stats().coalesced;
+    doc["queue"]["stale"] = jobQueue.stats().stale;
+    doc["queue"]["evicted"] = jobQueue.stats().evicted;
+    doc["queue"]["rejected"] = jobQueue.stats().rejected;
+    doc["queue"]["preempted"] = jobQueue.stats().preempted;
+    doc["refresh"]["requested"] = refreshStats.requested;
+    doc["refresh"]["notModified"] = refreshStats.notModified;
+    doc["refresh"]["updated"] = refreshStats.updated;
+    doc["refresh"]["skipped"] = refreshStats.skipped;
+    doc["refresh"]["failed"] = refreshStats.failed;
+    doc["retention"]["sweeps"] = retentionStats.sweeps;
+    doc["retention"]["deleted"] = retentionStats.deleted;
+    doc["retention"]["deletedKB"] = retentionStats.deletedBytes / 1024;
+    doc["retention"]["lastDeleted"] = retentionStats.lastDeleted;
+    doc["retention"]["lastSweepMs"] = retentionStats.lastSweepMs;
+    ImageCacheStats cacheStats = imageCache.stats();
+    doc["imageCache"]["hits"] = cacheStats.hits;
+    doc["imageCache"]["misses"] = cacheStats.misses;
+    doc["imageCache"]["evictions"] = cacheStats.evictions;
+    doc["imageCache"]["entries"] = cacheStats.entries;
+    doc["imageCache"]["bytesKB"] = cacheStats.bytes / 1024;
+    doc["imageCache"]["budgetKB"] = imageCache.budget() / 1024;
+    PrefetchStats prefetchStats = framePrefetch.stats();
+    doc["slideshow"]["prefetchDepth"] = framePrefetch.depth();
+    doc["slideshow"]["prefetchHits"] = prefetchStats.hits;
+    doc["slideshow"]["prefetchMisses"] = prefetchStats.misses;
+    doc["slideshow"]["decodes"] = prefetchStats.decodes;
+    doc["slideshow"]["decodeFailures"] = prefetchStats.decodeFailures;
+    doc["slideshow"]["lastDecodeMs"] = prefetchStats.lastDecodeMs;
+    doc["slideshow"]["lastFrameMs"] = prefetchStats.frameTime.lastMs;
+    doc["slideshow"]["maxFrameMs"] = prefetchStats.frameTime.maxMs;
+    for (int i = 0; i < FRAME_TIME_BUCKETS; i++) {
+      String bucket = i < FRAME_TIME_BUCKETS - 1 ? "<" + String(FRAME_TIME_BUCKET_MS[i])
+                                                  : ">=" + String(FRAME_TIME_BUCKET_MS[FRAME_TIME_BUCKETS - 2]);
+      doc["slideshow"]["frameTimeHistogramMs"][bucket] = prefetchStats.frameTime.counts[i];
+    }
+    request->send(200, "application/json", doc.as<String>());
+  });
+
+  // Registered before /latency, which would otherwise match it as a sub-path
+  server.on("/latency/traces", HTTP_GET, [](AsyncWebServerRequest *request) {
+    JsonDocument doc;
+    JsonArray traces = doc["traces"].to<JsonArray>();
+    for (const TraceRecord& record : latencyTracer.traces()) {
+      JsonObject entry = traces.add<JsonObject>();
+      entry["file"] = record.filename;
+      entry["attempts"] = record.trace.attempts;
+      entry["path"] = record.trace.tee ? "tee" : "sd";
+      unsigned long start = record.trace.at[STAGE_MQTT];
+      for (int s = STAGE_URL; s < LATENCY_STAGES; s++) {
+        if (record.trace.at[s] == 0) continue;
+        entry["stagesMs"][latencyStageToString((LatencyStage)s)] = record.trace.at[s] - start;
+      }
+    }
+    request->send(200, "application/json", doc.as<String>());
+  });
+
+  // Time from MQTT receipt to each stage, over all traced events
+  server.on("/latency", HTTP_GET, [](AsyncWebServerRequest *request) {
+    JsonDocument doc;
+    doc["events"] = latencyTracer.events();
+    for (int s = STAGE_URL; s < LATENCY_STAGES; s++) {
+      LatencyHistogram histogram = latencyTracer.histogram((LatencyStage)s);
+      JsonObject stage = doc["stagesMs"][latencyStageToString((LatencyStage)s)].to<JsonObject>();
+      stage["count"] = histogram.count();
+      stage["p50"] = histogram.percentile(0.50f);
+      stage["p95"] = histogram.percentile(0.95f);
+      stage["p99"] = histogram.percentile(0.99f);
+      stage["max"] = histogram.maxMs();
+    }
     request->send(200, "application/json", doc.as<String>());
   });
 
@@ -820,23 +1045,6 @@ void setupWiFi() {
   setupWebInterface();
 }
 
-void listDir(fs::FS &fs, const char *dirname, uint8_t levels)
-{
- File root = fs.open(dirname,"r");
- root.rewindDirectory();
-      
-  while (true)
-  {
-    File entry =  root.openNextFile();
-    if (!entry)
-    {break;}
-
-    Serial.printf("[SD_MMC] File: %s [size: %luB]\n", entry.name(), (unsigned long)entry.size());
-    entry.close();
-  }
-
-}
-
 void setup_SPIFFS() {
   if (!SPIFFS.begin(true)) {
     Serial.println("SPIFFS Mount Failed");
@@ -882,8 +1090,7 @@ void setupSD_MMC() {
     SD_MMC.mkdir("/events");
   }
 
-  Serial.println("[SD_MMC] Listing contents");
-  listDir(SD_MMC, "/events", 0);
+  eventIndex.begin();
   
 }
 
@@ -895,6 +1102,8 @@ void setupSD_MMC() {
 void setup() {
   Serial.begin(115200);
 
+  displayMutex = xSemaphoreCreateRecursiveMutex();
+
   setup_SPIFFS();
 
   tft.begin();
@@ -922,49 +1131,32 @@ void setup() {
   weatherTempMax = preferences.getFloat("max", 0.0);
   int timezoneVal = preferences.getInt("timezone", 0);
   maxImages = preferences.getInt("maxImages", 30);
+  maxStorageMB = preferences.getInt("maxStorageMB", 0);
+  maxAgeHours = preferences.getInt("maxAgeHours", 0);
+  maxImagesPerCamera = preferences.getInt("maxPerCamera", 0);
   slideshowInterval = preferences.getInt("slideInterval", 3000);
+  int prefetchDepth = preferences.getInt("prefetch", PREFETCH_DEFAULT_DEPTH);
+  String rules = preferences.getString("rules", "");
   preferences.end();
+  filterRules.compile(rules.length() > 0 ? rules : FilterRules::fromMode(mode));
 
   long gmtOffset_sec = timezoneVal * 3600L;
   Serial.printf("configTime: gmtOffset_sec = %ld\n", gmtOffset_sec);
   configTime(gmtOffset_sec, 0, "pool.ntp.org");
 
   setupSD_MMC();
+  imageCache.begin();
+  latencyTracer.begin();
+  framePrefetch.begin(prefetchDepth);
+  startRetentionTask();
 
   setupWiFi();
 
   setupMqtt();
 
 
-  if (WiFi.status() == WL_CONNECTED) {
-
-    http.end(); // Ensure any previous instance is closed
-
-    String healthCheckUrl = "http://" + frigateIP + ":" + String(frigatePort) + "/api/version";
-    http.setTimeout(20000);// allow plenty of time to establish the initial connection which can be 8-14 seconds
-    
-    http.begin(healthCheckUrl);
-    
-    Serial.println("[FRIGATE] Sending GET: " + healthCheckUrl);
-
-    unsigned long start = millis();
-    int httpCode = http.GET();
-    unsigned long end = millis();
-
-    Serial.printf("[FRIGATE] Elapsed time: %lu ms\n", end - start);
-
-    // Expected response: "Frigate is running. Alive and healthy!"
-    if (httpCode == 200) {
-      Serial.println("[FRIGATE] Successfully connected to Frigate API at: " + healthCheckUrl);
-      Serial.println("[FRIGATE] Frigate API v" + http.getString());
-    } else {
-      Serial.println("[ERROR] failed connecting to Frigate API at: " + healthCheckUrl + " with code: " + String(httpCode));
-      Serial.println("[ERROR] HTTP err message: " + http.errorToString(httpCode));
-    }
-
-    http.end();
-
-  } 
+  // The download task checks Frigate and warms up its connection in the background
+  startDownloadTask();
 
   fetchWeather();
   lastWeatherFetch = millis();
@@ -983,40 +1175,37 @@ void loop() {
     ESP.restart();
   }
 
-  if (imagePending) {
-    imagePending = false;
-    displayImageFromAPI(pendingImageUrl, pendingZone);
-  }
-
-  static wl_status_t lastStatus = WL_CONNECTED;
-  static unsigned long lastReconnectAttempt = 0;
+  // The download task owns the panel while it streams an event image to it
+  if (!panelClaimed() && lockDisplay(pdMS_TO_TICKS(20))) {
+    handleMqttNotices();
+    handleDownloadResults();
 
-  if (WiFi.status() == WL_CONNECTED && lastStatus != WL_CONNECTED && millis() - lastReconnectAttempt > MQTT_RECONNECT_INTERVAL) {
-    mqttClient.connect();
-    lastReconnectAttempt = millis();
-  }
-  lastStatus = WiFi.status();
+    if (slideshowActive) {
+      handleSlideshow();
+    }
 
-  if (slideshowActive) {
-    handleSlideshow();
-  }
+    if (currentScreen != "clock" && screenTimeout > 0 && millis() - screenSince > screenTimeout) {
+      setScreen("clock", 0, "timeout");
+    }
 
-  if (currentScreen != "clock" && screenTimeout > 0 && millis() - screenSince > screenTimeout) {
-    setScreen("clock", 0, "timeout");
+    if (currentScreen == "clock" && millis() - lastClockUpdate > CLOCK_REFRESH_INTERVAL) {
+      showClock();
+    }
+    unlockDisplay();
   }
 
-  if (millis() - lastFrigateRequest > FRIGATE_KEEPALIVE_INTERVAL) {
-    lastFrigateRequest = millis();
-    frigateKeepAlive();
-  }  
-
   if (millis() - lastWeatherFetch > WEATHER_REFRESH_INTERVAL) {
     lastWeatherFetch = millis();
     fetchWeather();
-    if (currentScreen == "clock") showClock();
   }
-
-  if (currentScreen == "clock" && millis() - lastClockUpdate > CLOCK_REFRESH_INTERVAL) {
+  // Redrawn once the panel is free; loop() never waits long for it
+  static bool weatherChanged = false;
+  if (handleWeather()) weatherChanged = true;
+  if (currentScreen != "clock") {
+    weatherChanged = false; // the clock is redrawn in full when it comes back
+  } else if (weatherChanged && !panelClaimed() && lockDisplay(pdMS_TO_TICKS(20))) {
     showClock();
+    unlockDisplay();
+    weatherChanged = false;
   }
 }
\ No newline at end of file
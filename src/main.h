@@ -2,13 +2,33 @@
 
 #include <Arduino.h>
 #include <TFT_eSPI.h>
-#include <HTTPClient.h>
 
 extern TFT_eSPI tft;
-extern HTTPClient http;
 
 extern int displayDuration;
 extern int maxImages;
+extern int maxStorageMB;
+extern int maxAgeHours;
+extern int maxImagesPerCamera;
 extern String mode;
+extern bool slideshowActive;
 
-void setScreen(const String& newScreen, unsigned long timeoutSec = 0, const char* by = "");
+// redraw = false when the event image is already on the panel
+void setScreen(const String& newScreen, unsigned long timeoutSec = 0, const char* by = "", bool redraw = true);
+
+// The panel shows an event preview: keep it up without counting it as an event
+void holdEventScreen(unsigned long timeoutSec, const char* by);
+
+// Redraws an updated event image if it is the one on the panel
+void redrawEventImage(const String& filename);
+
+// Serialises panel access between loop() and the download task
+bool lockDisplay(TickType_t wait = portMAX_DELAY);
+void unlockDisplay();
+
+// The download task is streaming an event image to the panel. It only holds
+// the display lock per decoded block; loop() keeps running but does not draw
+// until the claim is released, after the result is posted.
+void claimPanel();
+void releasePanel();
+bool panelClaimed();
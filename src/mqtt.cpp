@@ -2,9 +2,18 @@
 #include <ArduinoJson.h>
 #include "main.h" // For setScreen, tft, etc.
 #include <WiFi.h>
+#include "filterrules.h"
 #include "frigate.h"
+#include "mqttassembly.h"
+#include "mqttsnapshots.h"
+#include "objectevents.h"
+#include "retry.h"
+#include "reviewfilter.h"
+#include "reviews.h"
 
 AsyncMqttClient mqttClient;
+MqttParseStats mqttParseStats;
+MqttAssembler mqttAssembler;
 String mqttServer = "";
 int mqttPort = 1883;
 String mqttUser = "";
@@ -12,76 +21,329 @@ String mqttPass = "";
 
 const char* MQTT_TOPIC = "frigate/reviews";
 
+// ------------------------
+//  Reconnect state machine
+// ------------------------
+// A one-shot FreeRTOS timer drives every connect attempt: the callbacks only
+// record what happened and re-arm it, so nothing here blocks or waits for a
+// second disconnect to retry. The session is persistent under a stable client
+// ID and subscribed at QoS 1, so the broker holds events published while the
+// link is down and hands them over on reconnect.
+std::atomic<MqttLinkState> mqttLinkState{MQTT_LINK_IDLE};
+MqttLinkStats mqttLinkStats;
+static TimerHandle_t reconnectTimer = nullptr;
+static std::atomic<int> reconnectAttempt{0};
+static std::atomic<unsigned long> outageSince{0}; // millis() the link went down, 0 while up
+static char clientId[32];
+
+static void armReconnectTimer(unsigned long delayMs) {
+  TickType_t ticks = pdMS_TO_TICKS(delayMs);
+  xTimerChangePeriod(reconnectTimer, ticks > 0 ? ticks : 1, 0);
+}
+
+static void scheduleReconnect() {
+  mqttLinkStats.retryDelayMs = backoffDelay(reconnectAttempt++, MQTT_RECONNECT_MIN_DELAY, MQTT_RECONNECT_MAX_DELAY);
+  mqttLinkState = MQTT_LINK_BACKOFF;
+  armReconnectTimer(mqttLinkStats.retryDelayMs);
+}
+
+// Runs on the timer task
+static void reconnectTimerFired(TimerHandle_t timer) {
+  switch (mqttLinkState.load()) {
+    case MQTT_LINK_CONNECTED:
+      return;
+    case MQTT_LINK_CONNECTING:
+      // No connect or disconnect callback in time: drop the socket and back off
+      Serial.println("[MQTT] Connect timed out");
+      mqttLinkStats.timeouts++;
+      scheduleReconnect();
+      mqttClient.disconnect(true);
+      return;
+    case MQTT_LINK_IDLE:
+    case MQTT_LINK_BACKOFF:
+      break;
+  }
+  if (WiFi.status() != WL_CONNECTED) {
+    // Not a failed attempt: poll for WiFi without growing the backoff
+    mqttLinkState = MQTT_LINK_IDLE;
+    armReconnectTimer(MQTT_RECONNECT_MIN_DELAY);
+    return;
+  }
+  mqttLinkStats.attempts++;
+  mqttLinkState = MQTT_LINK_CONNECTING;
+  armReconnectTimer(MQTT_CONNECT_TIMEOUT);
+  mqttClient.connect();
+}
+
 void setupMqtt() {
   // Set up MQTT server, credentials, and callbacks
   mqttClient.onConnect(onMqttConnect);
   mqttClient.onDisconnect(onMqttDisconnect);
   mqttClient.onMessage(onMqttMessage);
 
+  // The broker keys the persistent session on the client ID, so it must survive reboots
+  snprintf(clientId, sizeof(clientId), "frigate-viewer-%012llx", ESP.getEfuseMac());
+  mqttClient.setClientId(clientId);
+  mqttClient.setCleanSession(false);
   mqttClient.setServer(mqttServer.c_str(), mqttPort);
   mqttClient.setCredentials(mqttUser.c_str(), mqttPass.c_str());
-  
-  if (WiFi.status() == WL_CONNECTED) mqttClient.connect();
 
+  reconnectTimer = xTimerCreate("mqttReconnect", pdMS_TO_TICKS(MQTT_RECONNECT_MIN_DELAY), pdFALSE, nullptr,
+                                reconnectTimerFired);
+  outageSince = millis();
+  armReconnectTimer(1);
 }
 
+void restartMqtt() {
+  if (!reconnectTimer) return;
+  mqttClient.setServer(mqttServer.c_str(), mqttPort);
+  mqttClient.setCredentials(mqttUser.c_str(), mqttPass.c_str());
+  reconnectAttempt = 0;
+  if (mqttClient.connected()) {
+    mqttClient.disconnect(); // onMqttDisconnect schedules the first attempt
+  } else {
+    mqttLinkState = MQTT_LINK_BACKOFF;
+    armReconnectTimer(1);
+  }
+}
 
 // ------------------------
-//  MQTT callbacks
+//  Notices to loop()
 // ------------------------
-void onMqttConnect(bool sessionPresent) {
-  Serial.println("[MQTT] Connected!");
-  mqttClient.subscribe(MQTT_TOPIC, 0);
-}
+// The callbacks run on the AsyncTCP task and must not touch the panel or the
+// screen state; they raise a flag here and loop() paints it. A burst of bad
+// payloads collapses into one repaint.
+static std::atomic<bool> parseErrorPending{false};
 
-void onMqttDisconnect(AsyncMqttClientDisconnectReason reason) {
-  static unsigned long lastReconnectAttempt = 0;
-  const unsigned long reconnectInterval = 50000;
-  Serial.print("[MQTT] Connection lost with reason: "); Serial.println(static_cast<int>(reason));
-  unsigned long now = millis();
-  if (now - lastReconnectAttempt >= reconnectInterval) {
-    setScreen("error", 50, "onMqttDisconnect");
+void handleMqttNotices() {
+  // Blips are bridged by the persistent session; only a real outage is shown, once
+  static bool outageShown = false;
+  unsigned long since = outageSince.load();
+  if (since == 0) {
+    outageShown = false;
+  } else if (!outageShown && millis() - since >= MQTT_OUTAGE_NOTICE_DELAY) {
+    outageShown = true;
+    setScreen("error", 50, "mqttOutage");
     tft.setTextColor(TFT_RED, TFT_BLACK);
     tft.setTextSize(2);
     tft.setCursor(0, 0);
     tft.println("MQTT ERROR!");
-    Serial.println("[MQTT] Attempting to reconnect...");
-    mqttClient.setServer(mqttServer.c_str(), mqttPort);
-    mqttClient.setCredentials(mqttUser.c_str(), mqttPass.c_str());
-    mqttClient.connect();
-    lastReconnectAttempt = now;
-  } else {
-    Serial.print("[MQTT] Waiting for next reconnect attempt in "); 
-    Serial.print((reconnectInterval - (now - lastReconnectAttempt)) / 1000);
-    Serial.println(" seconds");
   }
+
+  if (parseErrorPending.exchange(false)) {
+    setScreen("error", 30, "onMqttMessage");
+    tft.setTextColor(TFT_RED);
+    tft.setTextSize(2);
+    tft.println("JSON Parse Error");
+  }
+}
+
+// ------------------------
+//  MQTT callbacks
+// ------------------------
+void onMqttConnect(bool sessionPresent) {
+  unsigned long since = outageSince.exchange(0);
+  mqttLinkState = MQTT_LINK_CONNECTED;
+  reconnectAttempt = 0;
+  xTimerStop(reconnectTimer, 0);
+  mqttLinkStats.connects++;
+  if (since) mqttLinkStats.lastOutageMs = millis() - since;
+  Serial.printf("[MQTT] Connected as %s, session %s\n", clientId, sessionPresent ? "resumed" : "new");
+
+  // A resumed session keeps its subscriptions and replays what we missed
+  if (sessionPresent) {
+    mqttLinkStats.resumed++;
+    return;
+  }
+  mqttClient.subscribe(MQTT_TOPIC, 1);
+#if MQTT_SNAPSHOT_INGEST
+  // Retained and superseded by the next one; not worth queueing at the broker
+  mqttClient.subscribe(MQTT_SNAPSHOT_TOPIC, 0);
+#endif
+#if MQTT_EVENTS_INGEST
+  mqttClient.subscribe(MQTT_EVENTS_TOPIC, 1);
+#endif
+}
+
+void onMqttDisconnect(AsyncMqttClientDisconnectReason reason) {
+  unsigned long zero = 0;
+  outageSince.compare_exchange_strong(zero, millis());
+  mqttLinkStats.disconnects++;
+  mqttLinkStats.lastReason = static_cast<int>(reason);
+  // Already backing off when a timed-out attempt is torn down
+  if (!reconnectTimer || mqttLinkState == MQTT_LINK_BACKOFF) return;
+  scheduleReconnect();
+  Serial.printf("[MQTT] Connection lost with reason %d, retrying in %lu ms\n", static_cast<int>(reason),
+                mqttLinkStats.retryDelayMs);
 }
 
 // ------------------------
 //  MQTT message handler
 // ------------------------
-void onMqttMessage(
-    char* topic,
-    char* payload,
-    AsyncMqttClientMessageProperties properties,
-    size_t len,
-    size_t index,
-    size_t total
-) {
-  String payloadStr;
-  for (size_t i = 0; i < len; i++) payloadStr += (char)payload[i];
+#if MQTT_SNAPSHOT_INGEST
+// First object of a review, e.g. "person" from "person-verified"
+static String reviewLabel(JsonObject msg) {
+  JsonArray objects = msg["data"]["objects"].as<JsonArray>();
+  if (objects.isNull() || objects.size() == 0) return "";
+  String label = objects[0] | "";
+  int suffix = label.indexOf('-');
+  return suffix > 0 ? label.substring(0, suffix) : label;
+}
+
+// A JPEG on frigate/<camera>/<object>/snapshot, kept until a review claims it
+static void handleSnapshotMessage(const char* topic, const MqttPayload& payload, const String& camera, const String& label) {
+  uint8_t* jpeg = mqttAssembler.detach(topic, payload);
+  if (!jpeg) {
+    Serial.printf("[MQTT] No memory for the %s/%s snapshot\n", camera.c_str(), label.c_str());
+    return;
+  }
+  Serial.printf("[MQTT] Snapshot %s/%s: %u bytes\n", camera.c_str(), label.c_str(), (unsigned)payload.len);
+  mqttSnapshots.put(camera, label, jpeg, payload.len);
+}
+#endif
+
+// The zone a snapshot is filed under: the last one entered
+static String lastZone(JsonArray zones) {
+  if (zones.isNull() || zones.size() == 0) return "outside-zone";
+  return String(zones[zones.size() - 1].as<const char*>());
+}
+
+// The zone a detection's snapshot is filed under: the one it was prefetched
+// with if frigate/events got there first, so both paths name the same file
+static String detectionZone(const String& id, const String& reviewZone) {
+#if MQTT_EVENTS_INGEST
+  String zone;
+  if (objectEvents.fetchedZone(id, zone)) return zone;
+#endif
+  return reviewZone;
+}
+
+#if MQTT_EVENTS_INGEST
+// Queues a detection its review held back for the snapshot. A detection that
+// could not be queued stops waiting too, so it is not retried every message.
+static void queueHeldDetection(ActiveReview& review, ReviewDetection& detection, unsigned long receivedAt) {
+  detection.waiting = false;
+  String zone = detectionZone(detection.id, review.zone);
+  if (queueSnapshotDownload(frigateSnapshotUrl(detection.id), review.camera, zone, !review.announced, receivedAt,
+                            nullptr, 0, review.displaySec, review.rank)) {
+    detection.queued = true;
+    review.announced = true;
+    objectEvents.markFetched(detection.id, zone);
+  }
+}
+
+// Held detections whose snapshot never showed up are fetched like any other,
+// which retries for a while and then gives up as the review path always has
+static void releaseExpiredWaits(unsigned long receivedAt) {
+  ReviewDetection* detection = nullptr;
+  while (ActiveReview* review = reviewTracker.findExpiredWait(OBJECT_SNAPSHOT_WAIT_MS, detection)) {
+    Serial.println("[EVENTS] No snapshot in time, fetching anyway: " + detection->id);
+    objectEvents.stats().released++;
+    queueHeldDetection(*review, *detection, receivedAt);
+  }
+}
+
+// One frigate/events message: tracks whether Frigate has a snapshot for the
+// object and fetches it the moment it does, ahead of the review
+static void handleObjectEvent(const char* payload, size_t len, unsigned long receivedAt) {
+  static JsonDocument filter;
+  if (filter.isNull()) {
+    filter["type"] = true;
+    filter["after"]["id"] = true;
+    filter["after"]["camera"] = true;
+    filter["after"]["label"] = true;
+    filter["after"]["has_snapshot"] = true;
+    filter["after"]["snapshot"]["frame_time"] = true;
+    filter["after"]["entered_zones"] = true;
+  }
+
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, payload, len, DeserializationOption::Filter(filter));
+  if (error) {
+    Serial.print("[EVENTS] JSON parsing error: "); Serial.println(error.c_str());
+    return;
+  }
+
+  String type = doc["type"] | "";
+  JsonObject after = doc["after"].as<JsonObject>();
+  String id = after["id"] | "";
+  if (id.isEmpty()) return;
+
+  bool ended = type == "end";
+  double snapshotFrame = after["snapshot"]["frame_time"] | 0.0;
+  if (objectEvents.update(id, after["has_snapshot"] | false, snapshotFrame) && frigateIP.length() > 0) {
+    ReviewDetection* detection = nullptr;
+    ActiveReview* review = reviewTracker.findWaiting(id, detection);
+    if (review) {
+      // The review came first and held this detection back
+      queueHeldDetection(*review, *detection, receivedAt);
+    } else {
+      // Only what the filter rules could show; anything else would crowd out wanted images
+      JsonDocument labels;
+      labels.add(after["label"]);
+      JsonArray zones = after["entered_zones"].as<JsonArray>();
+      const char* camera = after["camera"] | "";
+      String zone = lastZone(zones);
+      if (!filterRules.mayShow(camera, labels.as<JsonArray>(), zones)) {
+        objectEvents.stats().filtered++;
+      } else if (queueSpeculativeDownload(frigateSnapshotUrl(id), camera, zone)) {
+        objectEvents.markFetched(id, zone);
+        objectEvents.stats().speculative++;
+        Serial.println("[EVENTS] Snapshot ready, fetching ahead of the review: " + id);
+      }
+    }
+  } else if (frigateIP.length() > 0 && objectEvents.refreshDue(id, ended)) {
+    // Frigate picked a better frame for the snapshot already on the card
+    String zone;
+    objectEvents.fetchedZone(id, zone);
+    queueSnapshotRefresh(frigateSnapshotUrl(id), after["camera"] | "", zone, true);
+  }
+  if (ended) {
+    // Frigate will not make a snapshot any more, e.g. has_snapshot stayed false;
+    // a review still holding the detection falls back to fetching it
+    ReviewDetection* detection = nullptr;
+    ActiveReview* review = reviewTracker.findWaiting(id, detection);
+    if (review) {
+      objectEvents.stats().released++;
+      queueHeldDetection(*review, *detection, receivedAt);
+    }
+    objectEvents.end(id);
+  }
+  releaseExpiredWaits(receivedAt);
+}
+#endif
+
+// The persistent session replays whatever the broker held during an outage. By
+// Frigate's own timestamps a review is history when it ended more than
+// displayDuration ago, or is first seen that long after it started.
+static bool outsideDisplayWindow(JsonObject msg, bool firstSeen) {
+  time_t now = time(nullptr);
+  if (now < 1600000000) return false; // no NTP time yet, nothing to compare with
+  double cutoff = (double)now - displayDuration;
+  if (!msg["end_time"].isNull()) return (msg["end_time"] | 0.0) < cutoff;
+  return firstSeen && (msg["start_time"] | (double)now) < cutoff;
+}
+
+// One complete frigate/reviews message; receivedAt is when its first fragment arrived
+static void handleReviewMessage(const char* topic, const char* payload, size_t len, unsigned long receivedAt) {
   Serial.println("====[MQTT RECEIVED]====");
   Serial.print("Topic:   "); Serial.println(topic);
-  Serial.print("Payload: "); Serial.println(payloadStr);
+#if MQTT_LOG_PAYLOAD
+  Serial.print("Payload: "); Serial.write((const uint8_t*)payload, len); Serial.println();
+#endif
 
+  unsigned long parseStart = micros();
   JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload, len);
+  DeserializationError error = deserializeJson(doc, payload, len, DeserializationOption::Filter(reviewFilter()));
+  mqttParseStats.lastParseUs = micros() - parseStart;
+  mqttParseStats.messages++;
+  mqttParseStats.payloadBytes += len;
+  mqttParseStats.totalParseUs += mqttParseStats.lastParseUs;
+  mqttParseStats.maxParseUs = max(mqttParseStats.maxParseUs, mqttParseStats.lastParseUs);
   if (error) {
+    mqttParseStats.errors++;
     Serial.print("[DEBUG] JSON parsing error: "); Serial.println(error.c_str());
-    setScreen("error", 30, "onMqttMessage");
-    tft.setTextColor(TFT_RED);
-    tft.setTextSize(2);
-    tft.println("JSON Parse Error");
+    parseErrorPending = true;
     return;
   }
 
@@ -91,7 +353,7 @@ void onMqttMessage(
 
   if (type == "new" && doc["before"].is<JsonObject>()) {
     msg = doc["before"].as<JsonObject>();
-  } else if (type == "update" && doc["after"].is<JsonObject>()) {
+  } else if ((type == "update" || type == "end") && doc["after"].is<JsonObject>()) {
     msg = doc["after"].as<JsonObject>();
   } else {
     Serial.println("[DEBUG] Ignoring message of type '" + type + "'");
@@ -100,33 +362,119 @@ void onMqttMessage(
 
   if (msg["severity"].is<String>()) severity = msg["severity"].as<String>();
 
-  String modeClean = mode; modeClean.trim(); modeClean.toLowerCase();
-  String severityClean = severity; severityClean.trim(); severityClean.toLowerCase();
-  bool show = modeClean.indexOf(severityClean) >= 0;
+  FilterDecision decision = filterRules.match(msg);
+  bool show = decision.show;
 
-  if (show && frigateIP.length() > 0 && msg["data"].is<JsonObject>() && msg["data"]["detections"].is<JsonArray>()) {
-    JsonArray detections = msg["data"]["detections"].as<JsonArray>();
-    JsonArray zonesArray = msg["data"]["zones"].is<JsonArray>() ? msg["data"]["zones"].as<JsonArray>() : JsonArray();
-    String zone = "outside-zone";
-    if (!zonesArray.isNull() && zonesArray.size() > 0) {
-      zone = String(zonesArray[zonesArray.size() - 1].as<const char*>());
-    }
-  
-    if (!detections.isNull() && detections.size() > 0) {
-      for (JsonVariant d : detections) {
-        String id = d.as<String>();
-        int dashIndex = id.indexOf("-");
-        String suffix = (dashIndex > 0) ? id.substring(dashIndex + 1) : id;
-        String filename = "/events/" + suffix + "-" + zone + ".jpg";
-        if (std::find(jpgQueue.begin(), jpgQueue.end(), filename) == jpgQueue.end()) {
-          jpgQueue.push_back(filename);
+  JsonArray detections = msg["data"]["detections"].is<JsonArray>() ? msg["data"]["detections"].as<JsonArray>() : JsonArray();
+  String reviewId = msg["id"] | "";
+  // Without an id every message stands alone, as before reviews were tracked
+  ActiveReview standalone;
+  bool firstSeen = reviewId.isEmpty() || !reviewTracker.contains(reviewId);
+  ActiveReview& review = reviewId.isEmpty() ? standalone : reviewTracker.observe(reviewId, severity, detections);
+  if (reviewId.isEmpty()) standalone.merge(detections);
+  if (!review.historic && outsideDisplayWindow(msg, firstSeen)) {
+    review.historic = true;
+    reviewTracker.countHistoric();
+    Serial.println("[REVIEW] Replayed from before the display window, gallery only: " + reviewId);
+  }
+
+  JsonArray zonesArray = msg["data"]["zones"].is<JsonArray>() ? msg["data"]["zones"].as<JsonArray>() : JsonArray();
+  String camera = msg["camera"] | "";
+  String zone = lastZone(zonesArray);
+  review.camera = camera;
+  review.zone = zone;
+  review.displaySec = decision.durationSec;
+  review.rank = eventRank(decision.priority, severity);
+
+  // Only detections not yet handed to the download task produce work; a review
+  // that escalates into the display mode queues everything it has seen so far
+  bool worked = false;
+  if (show && frigateIP.length() > 0 && review.hasPending()) {
+    // The first detection of a review jumps the queue for immediate display; the
+    // rest follow it and join the slideshow as they arrive
+    for (ReviewDetection& d : review.detections) {
+      if (d.queued) continue;
+      if (review.historic) {
+        if (queueGalleryDownload(frigateSnapshotUrl(d.id), camera, detectionZone(d.id, zone))) d.queued = true;
+        continue;
+      }
+#if MQTT_EVENTS_INGEST
+      // Frigate would answer 404 for now; frigate/events queues it once the snapshot
+      // exists. A review that ends, or a wait that runs out, fetches it regardless.
+      if (!reviewId.isEmpty() && type != "end" && objectEvents.readiness(d.id) == SNAPSHOT_PENDING &&
+          (!d.waiting || receivedAt - d.waitingSince < OBJECT_SNAPSHOT_WAIT_MS)) {
+        if (!d.waiting) {
+          objectEvents.stats().deferred++;
+          d.waiting = true;
+          d.waitingSince = receivedAt;
         }
+        continue;
+      }
+      d.waiting = false;
+#endif
+      uint8_t* jpeg = nullptr;
+      size_t jpegSize = 0;
+#if MQTT_SNAPSHOT_INGEST
+      // Frigate's snapshot topic has no event id, only the first detection can be matched
+      if (!review.announced) mqttSnapshots.take(camera, reviewLabel(msg), jpeg, jpegSize);
+#endif
+      String jobZone = detectionZone(d.id, zone);
+      if (queueSnapshotDownload(frigateSnapshotUrl(d.id), camera, jobZone, !review.announced, receivedAt, jpeg, jpegSize,
+                                review.displaySec, review.rank)) {
+        d.queued = true;
+        review.announced = true;
+#if MQTT_EVENTS_INGEST
+        objectEvents.markFetched(d.id, jobZone);
+#endif
       }
-      String url = "http://" + frigateIP + ":" + String(frigatePort) +
-                   "/api/events/" + detections[0].as<String>() + "/snapshot.jpg?crop=1&height=240";
-      imagePending = true;
-      pendingImageUrl = url;
-      pendingZone = zone;
     }
+    review.refreshedAt = receivedAt;
+    worked = true;
+  } else if (show && frigateIP.length() > 0 && !reviewId.isEmpty() && review.announced &&
+             (type == "end" || receivedAt - review.refreshedAt >= REVIEW_REFRESH_INTERVAL)) {
+    // Frigate keeps improving a detection's snapshot while the review runs; ask
+    // whether it has, which costs a 304 when it has not. Without validators this
+    // is a no-op and frigate/events, when followed, reports the changes instead.
+    for (const ReviewDetection& d : review.detections) {
+      if (d.queued) queueSnapshotRefresh(frigateSnapshotUrl(d.id), camera, detectionZone(d.id, zone), false);
+    }
+    review.refreshedAt = receivedAt;
+    worked = true;
+  }
+  if (!worked && !reviewId.isEmpty()) reviewTracker.countIdle();
+
+  if (type == "end" && !reviewId.isEmpty()) reviewTracker.end(reviewId);
+#if MQTT_EVENTS_INGEST
+  releaseExpiredWaits(receivedAt);
+#endif
+}
+
+void onMqttMessage(
+    char* topic,
+    char* payload,
+    AsyncMqttClientMessageProperties properties,
+    size_t len,
+    size_t index,
+    size_t total
+) {
+  MqttPayload message;
+  if (!mqttAssembler.add(topic, payload, len, index, total, message)) return;
+#if MQTT_SNAPSHOT_INGEST
+  String camera, label;
+  if (parseSnapshotTopic(topic, camera, label)) {
+    // A retained snapshot is from some earlier object, not the event to come
+    if (properties.retain) mqttAssembler.finish(topic);
+    else handleSnapshotMessage(topic, message, camera, label);
+    return;
+  }
+#endif
+#if MQTT_EVENTS_INGEST
+  if (strcmp(topic, MQTT_EVENTS_TOPIC) == 0) {
+    handleObjectEvent(message.data, message.len, message.firstAt);
+    mqttAssembler.finish(topic);
+    return;
   }
+#endif
+  handleReviewMessage(topic, message.data, message.len, message.firstAt);
+  mqttAssembler.finish(topic);
 }
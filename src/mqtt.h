@@ -2,14 +2,66 @@
 
 #include <Arduino.h>
 #include <AsyncMqttClient.h>
+#include <atomic>
+#include "mqttassembly.h"
+
+// Print every received payload to Serial. Off by default: a busy review is
+// several KB and printing it stalls the MQTT task.
+#ifndef MQTT_LOG_PAYLOAD
+#define MQTT_LOG_PAYLOAD 0
+#endif
+
+// Reconnect backoff: a jittered delay doubling from the minimum up to the maximum
+const unsigned long MQTT_RECONNECT_MIN_DELAY = 1000;
+const unsigned long MQTT_RECONNECT_MAX_DELAY = 60000;
+// A connect attempt with no answer by then is abandoned and retried
+const unsigned long MQTT_CONNECT_TIMEOUT = 15000;
+// Outages shorter than this are only logged; the broker replays what was missed
+const unsigned long MQTT_OUTAGE_NOTICE_DELAY = 60000;
+
+enum MqttLinkState : uint8_t {
+  MQTT_LINK_IDLE,        // waiting for WiFi
+  MQTT_LINK_CONNECTING,
+  MQTT_LINK_CONNECTED,
+  MQTT_LINK_BACKOFF      // waiting for the next attempt
+};
+
+struct MqttLinkStats {
+  uint32_t attempts = 0;
+  uint32_t connects = 0;
+  uint32_t resumed = 0;          // connects where the broker kept our session
+  uint32_t disconnects = 0;
+  uint32_t timeouts = 0;
+  int lastReason = -1;           // AsyncMqttClientDisconnectReason, -1 = none yet
+  unsigned long retryDelayMs = 0;
+  unsigned long lastOutageMs = 0;
+};
+
+struct MqttParseStats {
+  uint32_t messages = 0;
+  uint32_t errors = 0;
+  uint32_t payloadBytes = 0;
+  unsigned long lastParseUs = 0;
+  unsigned long maxParseUs = 0;
+  unsigned long totalParseUs = 0;
+};
 
 extern AsyncMqttClient mqttClient;
+extern MqttParseStats mqttParseStats;
+extern MqttLinkStats mqttLinkStats;
+extern std::atomic<MqttLinkState> mqttLinkState;
+extern MqttAssembler mqttAssembler;
 extern String mqttServer;
 extern int mqttPort;
 extern String mqttUser;
 extern String mqttPass;
 
 void setupMqtt();
+// Applies changed server settings and reconnects now, e.g. after /save
+void restartMqtt();
+// Called from loop() with the panel locked: paints a parse error the callbacks
+// flagged, and the error screen once an outage outlasts MQTT_OUTAGE_NOTICE_DELAY
+void handleMqttNotices();
 void onMqttConnect(bool sessionPresent);
 void onMqttDisconnect(AsyncMqttClientDisconnectReason reason);
 void onMqttMessage(
@@ -0,0 +1,110 @@
+#include "mqttassembly.h"
+
+MqttAssembler::Slot* MqttAssembler::find(const char* topic) {
+  for (Slot& slot : _slots) {
+    if (slot.topic == topic) return &slot;
+  }
+  return nullptr;
+}
+
+void MqttAssembler::drop(Slot& slot) {
+  free(slot.buffer);
+  _slots.erase(_slots.begin() + (&slot - _slots.data()));
+}
+
+void MqttAssembler::expire(unsigned long now) {
+  for (auto it = _slots.begin(); it != _slots.end();) {
+    // A buffer handed out by add() is the caller's until finish()
+    bool complete = it->received == it->total;
+    if (!complete && now - it->lastAt > _timeoutMs) {
+      Serial.printf("[MQTT] Gave up on %s after %u/%u bytes\n", it->topic.c_str(), (unsigned)it->received, (unsigned)it->total);
+      free(it->buffer);
+      it = _slots.erase(it);
+      _stats.timedOut++;
+    } else {
+      ++it;
+    }
+  }
+}
+
+bool MqttAssembler::add(const char* topic, char* payload, size_t len, size_t index, size_t total, MqttPayload& out) {
+  unsigned long now = millis();
+  expire(now);
+
+  if (total > _maxSize) {
+    if (index == 0) {
+      Serial.printf("[MQTT] Payload of %u bytes on %s exceeds %u, dropped\n", (unsigned)total, topic, (unsigned)_maxSize);
+      _stats.oversized++;
+    }
+    return false;
+  }
+
+  // The common case: the whole message in one piece
+  if (index == 0 && len == total) {
+    out.data = payload;
+    out.len = len;
+    out.firstAt = now;
+    return true;
+  }
+
+  Slot* slot = find(topic);
+  if (index == 0) {
+    if (slot) drop(*slot); // a new message replaces an unfinished one
+    if (_slots.size() >= (size_t)MQTT_ASSEMBLY_SLOTS) {
+      _stats.dropped++;
+      return false;
+    }
+    Slot fresh;
+    fresh.topic = topic;
+    fresh.buffer = (char*)ps_malloc(total);
+    if (!fresh.buffer) {
+      Serial.printf("[MQTT] No memory for a %u byte payload on %s\n", (unsigned)total, topic);
+      _stats.dropped++;
+      return false;
+    }
+    fresh.total = total;
+    fresh.startedAt = now;
+    _slots.push_back(fresh);
+    slot = &_slots.back();
+    _stats.fragmented++;
+  } else if (!slot || index != slot->received || total != slot->total) {
+    // Its start was dropped or a piece went missing; wait for the next message
+    if (slot) drop(*slot);
+    _stats.dropped++;
+    return false;
+  }
+
+  if (index + len > slot->total) {
+    drop(*slot);
+    _stats.dropped++;
+    return false;
+  }
+  memcpy(slot->buffer + index, payload, len);
+  slot->received += len;
+  slot->lastAt = now;
+  if (slot->received < slot->total) return false;
+
+  out.data = slot->buffer;
+  out.len = slot->total;
+  out.firstAt = slot->startedAt;
+  _stats.largest = max(_stats.largest, slot->total);
+  return true;
+}
+
+void MqttAssembler::finish(const char* topic) {
+  Slot* slot = find(topic);
+  if (slot && slot->received == slot->total) drop(*slot);
+}
+
+uint8_t* MqttAssembler::detach(const char* topic, const MqttPayload& payload) {
+  Slot* slot = find(topic);
+  if (slot && slot->buffer == payload.data) {
+    uint8_t* data = (uint8_t*)slot->buffer;
+    slot->buffer = nullptr;
+    drop(*slot);
+    return data;
+  }
+  uint8_t* copy = (uint8_t*)ps_malloc(payload.len);
+  if (copy) memcpy(copy, payload.data, payload.len);
+  return copy;
+}
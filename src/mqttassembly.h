@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Largest payload put back together; bigger messages are dropped
+const size_t MQTT_MAX_PAYLOAD = 64 * 1024;
+// A message whose fragments stop arriving for this long is abandoned
+const unsigned long MQTT_FRAGMENT_TIMEOUT = 5000;
+// Topics that may be mid-message at once
+const int MQTT_ASSEMBLY_SLOTS = 4;
+
+// A complete message. data stays valid until finish() is called for its topic.
+struct MqttPayload {
+  char* data = nullptr;
+  size_t len = 0;
+  unsigned long firstAt = 0;  // millis() of the first fragment
+};
+
+struct MqttAssemblyStats {
+  uint32_t fragmented = 0;    // messages that arrived in more than one piece
+  uint32_t oversized = 0;
+  uint32_t timedOut = 0;
+  uint32_t dropped = 0;       // out of order, out of slots or out of memory
+  size_t largest = 0;
+};
+
+// ------------------------
+//  MQTT fragment reassembly
+// ------------------------
+// AsyncMqttClient hands over a payload larger than its buffer in pieces, each
+// with its offset and the total size. Pieces are copied into a PSRAM buffer of
+// the announced size, one per topic, and only a complete message is returned.
+// A message that fits one piece is passed through without a copy. MQTT task only.
+class MqttAssembler {
+public:
+  MqttAssembler(size_t maxSize = MQTT_MAX_PAYLOAD, unsigned long timeoutMs = MQTT_FRAGMENT_TIMEOUT)
+    : _maxSize(maxSize), _timeoutMs(timeoutMs) {}
+
+  // True once the message is complete, with out pointing at the whole payload
+  bool add(const char* topic, char* payload, size_t len, size_t index, size_t total, MqttPayload& out);
+  // Releases the buffer behind the payload add() returned for this topic
+  void finish(const char* topic);
+  // Takes ownership of that buffer instead, a ps_malloc'd copy when the message
+  // came in one piece; nullptr without memory. finish() is not needed after it.
+  uint8_t* detach(const char* topic, const MqttPayload& payload);
+
+  const MqttAssemblyStats& stats() const { return _stats; }
+
+private:
+  struct Slot {
+    String topic;
+    char* buffer = nullptr;
+    size_t total = 0;
+    size_t received = 0;
+    unsigned long startedAt = 0;
+    unsigned long lastAt = 0;
+  };
+
+  Slot* find(const char* topic);
+  void drop(Slot& slot);
+  void expire(unsigned long now);
+
+  size_t _maxSize;
+  unsigned long _timeoutMs;
+  std::vector<Slot> _slots;
+  MqttAssemblyStats _stats;
+};
@@ -0,0 +1,64 @@
+#include "mqttsnapshots.h"
+
+MqttSnapshotStore mqttSnapshots;
+
+bool parseSnapshotTopic(const char* topic, String& camera, String& label) {
+  String t = topic;
+  if (!t.startsWith("frigate/") || !t.endsWith("/snapshot")) return false;
+  int first = strlen("frigate/");
+  int second = t.indexOf('/', first);
+  int last = t.length() - strlen("/snapshot");
+  if (second <= first || second >= last) return false;
+  camera = t.substring(first, second);
+  label = t.substring(second + 1, last);
+  return label.indexOf('/') < 0;
+}
+
+void MqttSnapshotStore::put(const String& camera, const String& label, uint8_t* data, size_t size) {
+  _stats.received++;
+  for (Entry& entry : _entries) {
+    if (entry.camera == camera && entry.label == label) {
+      free(entry.data);
+      entry.data = data;
+      entry.size = size;
+      entry.receivedAt = millis();
+      _stats.replaced++;
+      return;
+    }
+  }
+  if (_entries.size() >= (size_t)MQTT_SNAPSHOT_SLOTS) {
+    unsigned long now = millis();
+    auto oldest = _entries.begin();
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+      if (now - it->receivedAt > now - oldest->receivedAt) oldest = it;
+    }
+    free(oldest->data);
+    _entries.erase(oldest);
+  }
+  Entry entry;
+  entry.camera = camera;
+  entry.label = label;
+  entry.data = data;
+  entry.size = size;
+  entry.receivedAt = millis();
+  _entries.push_back(entry);
+}
+
+bool MqttSnapshotStore::take(const String& camera, const String& label, uint8_t*& data, size_t& size) {
+  for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+    if (it->camera != camera || it->label != label) continue;
+    bool recent = millis() - it->receivedAt <= MQTT_SNAPSHOT_MAX_AGE;
+    if (recent) {
+      data = it->data;
+      size = it->size;
+      _stats.matched++;
+    } else {
+      free(it->data);
+    }
+    _entries.erase(it);
+    if (!recent) _stats.missed++;
+    return recent;
+  }
+  _stats.missed++;
+  return false;
+}
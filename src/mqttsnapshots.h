@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Take event snapshots from Frigate's frigate/<camera>/<object>/snapshot topics
+// instead of fetching them over HTTP. Needs `mqtt: enabled` on the cameras; keep
+// Frigate's default mqtt crop and height so the JPEG suits the panel. Build with
+// -DMQTT_SNAPSHOT_INGEST=1 to enable.
+#ifndef MQTT_SNAPSHOT_INGEST
+#define MQTT_SNAPSHOT_INGEST 0
+#endif
+
+const char* const MQTT_SNAPSHOT_TOPIC = "frigate/+/+/snapshot";
+// A snapshot older than this when a review asks for it belongs to an earlier object
+const unsigned long MQTT_SNAPSHOT_MAX_AGE = 15000;
+// Camera/label pairs held at once; the oldest is dropped first
+const int MQTT_SNAPSHOT_SLOTS = 4;
+
+struct MqttSnapshotStats {
+  uint32_t received = 0;
+  uint32_t matched = 0;     // used for a review instead of an HTTP fetch
+  uint32_t missed = 0;      // no recent snapshot, fetched over HTTP
+  uint32_t replaced = 0;    // a newer snapshot arrived before any review used it
+};
+
+// ------------------------
+//  MQTT snapshot store
+// ------------------------
+// The latest JPEG per camera and label, waiting for the review that needs it.
+// Frigate's topic carries no event id, so a review takes the newest snapshot of
+// its camera and first object label if it is recent. MQTT task only; stats()
+// may be read from others.
+class MqttSnapshotStore {
+public:
+  // Takes ownership of a ps_malloc'd JPEG
+  void put(const String& camera, const String& label, uint8_t* data, size_t size);
+  // Hands over the snapshot, which the caller then owns; false when none is recent
+  bool take(const String& camera, const String& label, uint8_t*& data, size_t& size);
+
+  const MqttSnapshotStats& stats() const { return _stats; }
+
+private:
+  struct Entry {
+    String camera;
+    String label;
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    unsigned long receivedAt = 0;
+  };
+
+  std::vector<Entry> _entries;
+  MqttSnapshotStats _stats;
+};
+
+// "frigate/<camera>/<object>/snapshot" -> camera and label; false for other topics
+bool parseSnapshotTopic(const char* topic, String& camera, String& label);
+
+extern MqttSnapshotStore mqttSnapshots;
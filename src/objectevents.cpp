@@ -0,0 +1,84 @@
+#include "objectevents.h"
+
+ObjectEventTracker objectEvents;
+
+bool ObjectEventTracker::update(const String& id, bool hasSnapshot, double snapshotFrame) {
+  _stats.messages++;
+  unsigned long now = millis();
+  for (Entry& entry : _events) {
+    if (entry.id != id) continue;
+    bool becameReady = hasSnapshot && !entry.hasSnapshot;
+    entry.hasSnapshot = entry.hasSnapshot || hasSnapshot;
+    if (snapshotFrame > entry.snapshotFrame) entry.snapshotFrame = snapshotFrame;
+    entry.updatedAt = now;
+    if (becameReady) _stats.ready++;
+    return becameReady;
+  }
+
+  if (_events.size() >= (size_t)OBJECT_EVENT_TABLE_SIZE) {
+    auto oldest = _events.begin();
+    for (auto it = _events.begin(); it != _events.end(); ++it) {
+      if (now - it->updatedAt > now - oldest->updatedAt) oldest = it;
+    }
+    _events.erase(oldest);
+  }
+  Entry entry;
+  entry.id = id;
+  entry.hasSnapshot = hasSnapshot;
+  entry.snapshotFrame = snapshotFrame;
+  entry.updatedAt = now;
+  _events.push_back(entry);
+  if (hasSnapshot) _stats.ready++;
+  return hasSnapshot;
+}
+
+void ObjectEventTracker::end(const String& id) {
+  for (auto it = _events.begin(); it != _events.end(); ++it) {
+    if (it->id == id) {
+      // A prefetched one stays until evicted, for a review that comes late
+      if (it->zone.isEmpty()) _events.erase(it);
+      return;
+    }
+  }
+}
+
+void ObjectEventTracker::markFetched(const String& id, const String& zone) {
+  for (Entry& entry : _events) {
+    if (entry.id == id) {
+      if (entry.zone.isEmpty()) entry.zone = zone;
+      entry.fetchedFrame = entry.snapshotFrame;
+      entry.fetchedAt = millis();
+      return;
+    }
+  }
+}
+
+bool ObjectEventTracker::refreshDue(const String& id, bool ended) {
+  for (Entry& entry : _events) {
+    if (entry.id != id) continue;
+    if (entry.zone.isEmpty() || entry.snapshotFrame <= entry.fetchedFrame) return false;
+    if (!ended && millis() - entry.fetchedAt < OBJECT_REFRESH_INTERVAL) return false;
+    entry.fetchedFrame = entry.snapshotFrame;
+    entry.fetchedAt = millis();
+    _stats.improved++;
+    return true;
+  }
+  return false;
+}
+
+bool ObjectEventTracker::fetchedZone(const String& id, String& zone) const {
+  for (const Entry& entry : _events) {
+    if (entry.id == id && !entry.zone.isEmpty()) {
+      zone = entry.zone;
+      return true;
+    }
+  }
+  return false;
+}
+
+SnapshotReadiness ObjectEventTracker::readiness(const String& id) const {
+  for (const Entry& entry : _events) {
+    if (entry.id == id) return entry.hasSnapshot ? SNAPSHOT_READY : SNAPSHOT_PENDING;
+  }
+  return SNAPSHOT_UNKNOWN;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Follow frigate/events as well as frigate/reviews. Object events arrive before
+// the review that groups them, so a snapshot can be fetched the moment Frigate
+// has one. Off by default; build with -DMQTT_EVENTS_INGEST=1 to enable.
+#ifndef MQTT_EVENTS_INGEST
+#define MQTT_EVENTS_INGEST 0
+#endif
+
+const char* const MQTT_EVENTS_TOPIC = "frigate/events";
+// Tracked objects remembered at once; the least recently updated is dropped first
+const int OBJECT_EVENT_TABLE_SIZE = 24;
+// Longest a review detection is held for its snapshot before it is fetched
+// anyway; Frigate never makes one for some objects, e.g. outside required zones
+const unsigned long OBJECT_SNAPSHOT_WAIT_MS = 10000;
+// Minimum time between re-fetches of an object's improving snapshot; the last
+// change before the object ends is always fetched
+const unsigned long OBJECT_REFRESH_INTERVAL = 20000;
+
+enum SnapshotReadiness {
+  SNAPSHOT_UNKNOWN,   // no frigate/events message seen for this id
+  SNAPSHOT_PENDING,   // the object is tracked but Frigate has no snapshot yet
+  SNAPSHOT_READY
+};
+
+struct ObjectEventStats {
+  uint32_t messages = 0;
+  uint32_t ready = 0;         // objects whose snapshot became available
+  uint32_t speculative = 0;   // fetched before any review asked for them
+  uint32_t filtered = 0;      // not fetched ahead, no filter rule would show them
+  uint32_t improved = 0;      // refreshes queued because Frigate picked a better snapshot
+  uint32_t deferred = 0;      // review detections held until their snapshot existed
+  uint32_t released = 0;      // held detections fetched anyway: object ended or waited too long
+};
+
+// ------------------------
+//  Object snapshot readiness
+// ------------------------
+// Whether Frigate has a snapshot for each tracked object, from the has_snapshot
+// field of frigate/events, and which frame it was taken from, which changes
+// when Frigate picks a better one. MQTT task only; stats() may be read from others.
+class ObjectEventTracker {
+public:
+  // Records the message; true when this one made the snapshot available.
+  // snapshotFrame is the frame_time of Frigate's current best snapshot.
+  bool update(const String& id, bool hasSnapshot, double snapshotFrame);
+  void end(const String& id);
+  SnapshotReadiness readiness(const String& id) const;
+  // The zone the object's snapshot was first downloaded under. Later fetches of
+  // it, from the review or a refresh, must use the same one or the filename differs.
+  void markFetched(const String& id, const String& zone);
+  bool fetchedZone(const String& id, String& zone) const;
+  // True when Frigate's snapshot changed since it was downloaded and a refresh
+  // is due: throttled while tracked, always on the object's last message.
+  bool refreshDue(const String& id, bool ended);
+
+  ObjectEventStats& stats() { return _stats; }
+
+private:
+  struct Entry {
+    String id;
+    bool hasSnapshot = false;
+    String zone;            // set once downloaded
+    double snapshotFrame = 0;
+    double fetchedFrame = 0;
+    unsigned long fetchedAt = 0;
+    unsigned long updatedAt = 0;
+  };
+
+  std::vector<Entry> _events;
+  ObjectEventStats _stats;
+};
+
+extern ObjectEventTracker objectEvents;
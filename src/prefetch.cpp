@@ -0,0 +1,217 @@
+#include "prefetch.h"
+#include "main.h" // For tft, lockDisplay
+#include "imagecache.h"
+#include "jpegstream.h"
+
+FramePrefetcher framePrefetch;
+
+static JpegStreamDecoder prefetchDecoder;
+static uint32_t useCounter = 0;
+
+void FrameTimeHistogram::record(unsigned long ms) {
+  int bucket = 0;
+  while (bucket < FRAME_TIME_BUCKETS - 1 && ms >= FRAME_TIME_BUCKET_MS[bucket]) bucket++;
+  counts[bucket]++;
+  lastMs = ms;
+  if (ms > maxMs) maxMs = ms;
+}
+
+void FramePrefetcher::begin(int depth) {
+  if (_task) return;
+  _mutex = xSemaphoreCreateMutex();
+  _requests = xQueueCreate(PREFETCH_MAX_DEPTH, sizeof(int));
+  xTaskCreatePinnedToCore(taskMain, "prefetch", PREFETCH_TASK_STACK, this, 1, &_task, PREFETCH_TASK_CORE);
+  setDepth(depth);
+}
+
+// Frees the frames no longer in use. Holds the display lock so loop() cannot be pushing one.
+void FramePrefetcher::setDepth(int depth) {
+  if (!psramFound()) depth = 0;
+  depth = constrain(depth, 0, PREFETCH_MAX_DEPTH);
+
+  lockDisplay();
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  _depth = depth;
+  for (int i = depth; i < PREFETCH_MAX_DEPTH; i++) {
+    Slot& slot = _slots[i];
+    if (slot.state == SLOT_EMPTY || slot.state == SLOT_READY) {
+      releaseSlotLocked(slot);
+      free(slot.pixels);
+      slot.pixels = nullptr;
+    }
+  }
+  xSemaphoreGive(_mutex);
+  unlockDisplay();
+
+  Serial.printf("[PREFETCH] Depth: %d frames (%u KB PSRAM)\n", depth, (unsigned)(depth * FRAME_BYTES / 1024));
+}
+
+// Keeps the frame buffer for reuse; only setDepth() and the task give it back
+void FramePrefetcher::releaseSlotLocked(Slot& slot) {
+  slot.state = SLOT_EMPTY;
+  slot.name = "";
+  slot.discard = false;
+}
+
+// ------------------------
+//  loop() side
+// ------------------------
+bool FramePrefetcher::request(const String& filename) {
+  if (_depth == 0) return false;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+
+  int target = -1;
+  for (int i = 0; i < _depth; i++) {
+    Slot& slot = _slots[i];
+    if (slot.state != SLOT_EMPTY && !slot.discard && slot.name == filename) {
+      slot.lastUsed = ++useCounter;
+      xSemaphoreGive(_mutex);
+      return true;
+    }
+    // An empty slot, else the ready frame shown or requested longest ago
+    if (slot.state == SLOT_EMPTY) {
+      if (target < 0 || _slots[target].state != SLOT_EMPTY) target = i;
+    } else if (slot.state == SLOT_READY) {
+      if (target < 0 || (_slots[target].state == SLOT_READY && slot.lastUsed < _slots[target].lastUsed)) target = i;
+    }
+  }
+
+  if (target < 0) {
+    xSemaphoreGive(_mutex);
+    return false;
+  }
+  Slot& slot = _slots[target];
+  if (!slot.pixels) slot.pixels = (uint16_t*)ps_malloc(FRAME_BYTES);
+  if (!slot.pixels) {
+    xSemaphoreGive(_mutex);
+    Serial.println("[PREFETCH] Frame allocation failed");
+    return false;
+  }
+  slot.name = filename;
+  slot.state = SLOT_PENDING;
+  slot.discard = false;
+  slot.lastUsed = ++useCounter;
+  xSemaphoreGive(_mutex);
+
+  xQueueSend(_requests, &target, 0);
+  return true;
+}
+
+bool FramePrefetcher::show(const String& filename) {
+  if (_depth == 0) return false;
+  uint16_t* pixels = nullptr;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (int i = 0; i < _depth; i++) {
+    Slot& slot = _slots[i];
+    if (slot.state == SLOT_READY && slot.name == filename) {
+      slot.lastUsed = ++useCounter;
+      pixels = slot.pixels;
+      break;
+    }
+  }
+  xSemaphoreGive(_mutex);
+  if (!pixels) return false;
+
+  // Only loop() reuses a ready frame, so it stays valid while it is pushed
+  tft.pushImage(0, 0, FRAME_WIDTH, FRAME_HEIGHT, pixels);
+  return true;
+}
+
+void FramePrefetcher::invalidate(const String& filename) {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (int i = 0; i < PREFETCH_MAX_DEPTH; i++) {
+    Slot& slot = _slots[i];
+    if (slot.name != filename) continue;
+    if (slot.state == SLOT_READY) releaseSlotLocked(slot);
+    else if (slot.state != SLOT_EMPTY) slot.discard = true;
+  }
+  xSemaphoreGive(_mutex);
+}
+
+void FramePrefetcher::clear() {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  for (int i = 0; i < PREFETCH_MAX_DEPTH; i++) {
+    Slot& slot = _slots[i];
+    if (slot.state == SLOT_READY) releaseSlotLocked(slot);
+    else if (slot.state != SLOT_EMPTY) slot.discard = true;
+  }
+  xSemaphoreGive(_mutex);
+}
+
+void FramePrefetcher::recordFrameTime(unsigned long ms, bool hit) {
+  if (!_mutex) return;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  if (hit) _stats.hits++;
+  else _stats.misses++;
+  _stats.frameTime.record(ms);
+  xSemaphoreGive(_mutex);
+}
+
+PrefetchStats FramePrefetcher::stats() {
+  if (!_mutex) return _stats;
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  PrefetchStats copy = _stats;
+  xSemaphoreGive(_mutex);
+  return copy;
+}
+
+// ------------------------
+//  Decoder task
+// ------------------------
+void FramePrefetcher::decodeSlot(int index) {
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  Slot& slot = _slots[index];
+  if (slot.state != SLOT_PENDING) {
+    xSemaphoreGive(_mutex);
+    return;
+  }
+  if (slot.discard || index >= _depth) {
+    releaseSlotLocked(slot);
+    xSemaphoreGive(_mutex);
+    return;
+  }
+  slot.state = SLOT_DECODING;
+  String filename = slot.name;
+  uint16_t* pixels = slot.pixels;
+  xSemaphoreGive(_mutex);
+
+  unsigned long start = millis();
+  bool decoded = false;
+  CachedImageRef image = imageCache.load(filename);
+  if (image) {
+    MemoryJpegSource source(image->data, image->size);
+    FrameJpegSink sink(pixels, FRAME_WIDTH, FRAME_HEIGHT);
+    JRESULT result = prefetchDecoder.decode(source, sink);
+    // JDR_INTR means the sink stopped at the bottom of the frame
+    decoded = result == JDR_OK || result == JDR_INTR;
+  }
+  if (!decoded) Serial.println("[PREFETCH] Decode failed: " + filename);
+
+  xSemaphoreTake(_mutex, portMAX_DELAY);
+  if (decoded) _stats.decodes++;
+  else _stats.decodeFailures++;
+  _stats.lastDecodeMs = millis() - start;
+  if (decoded && !slot.discard && index < _depth) {
+    slot.state = SLOT_READY;
+  } else {
+    releaseSlotLocked(slot);
+    if (index >= _depth) {
+      // Depth was lowered while decoding; a decoding slot is never on the panel
+      free(slot.pixels);
+      slot.pixels = nullptr;
+    }
+  }
+  xSemaphoreGive(_mutex);
+}
+
+void FramePrefetcher::taskMain(void* arg) {
+  FramePrefetcher* self = (FramePrefetcher*)arg;
+  int index;
+  while (true) {
+    if (xQueueReceive(self->_requests, &index, portMAX_DELAY) == pdTRUE) {
+      self->decodeSlot(index);
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Full-screen RGB565 frames decoded ahead of the slideshow
+const uint16_t FRAME_WIDTH = 240;
+const uint16_t FRAME_HEIGHT = 240;
+const size_t FRAME_BYTES = (size_t)FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint16_t);
+
+// Decoder task runs on the core loop() does not use
+const int PREFETCH_TASK_CORE = 0;
+const uint32_t PREFETCH_TASK_STACK = 6144;
+// Frames decoded ahead; each one costs FRAME_BYTES of PSRAM. 0 disables prefetching.
+const int PREFETCH_MAX_DEPTH = 4;
+const int PREFETCH_DEFAULT_DEPTH = 2;
+
+// Slide transition times, from the interval boundary until the frame is on the panel
+const int FRAME_TIME_BUCKETS = 8;
+const unsigned long FRAME_TIME_BUCKET_MS[FRAME_TIME_BUCKETS - 1] = {10, 20, 30, 50, 100, 200, 500};
+
+struct FrameTimeHistogram {
+  uint32_t counts[FRAME_TIME_BUCKETS] = {};
+  unsigned long lastMs = 0;
+  unsigned long maxMs = 0;
+  void record(unsigned long ms);
+};
+
+struct PrefetchStats {
+  uint32_t hits = 0;          // slide pushed from a ready frame
+  uint32_t misses = 0;        // slide decoded on the spot
+  uint32_t decodes = 0;
+  uint32_t decodeFailures = 0;
+  unsigned long lastDecodeMs = 0;
+  FrameTimeHistogram frameTime;
+};
+
+// ------------------------
+//  Slideshow frame prefetch
+// ------------------------
+// loop() asks for the next slides with request(); a task on the other core
+// decodes them into PSRAM frames, and show() pushes a ready frame in one
+// window write instead of clearing the panel and decoding in place.
+class FramePrefetcher {
+public:
+  void begin(int depth = PREFETCH_DEFAULT_DEPTH);
+  void setDepth(int depth);
+  int depth() const { return _depth; }
+
+  // Queues a decode unless the frame is ready or on its way; false when no slot is free
+  bool request(const String& filename);
+  // Pushes the frame if it is ready; false means the caller has to draw it itself
+  bool show(const String& filename);
+  // The file changed or was deleted
+  void invalidate(const String& filename);
+  void clear();
+
+  void recordFrameTime(unsigned long ms, bool hit);
+  PrefetchStats stats();
+
+private:
+  enum SlotState { SLOT_EMPTY, SLOT_PENDING, SLOT_DECODING, SLOT_READY };
+  struct Slot {
+    String name;
+    uint16_t* pixels = nullptr;
+    SlotState state = SLOT_EMPTY;
+    bool discard = false;     // invalidated while the task was decoding it
+    unsigned long lastUsed = 0;
+  };
+
+  static void taskMain(void* arg);
+  void decodeSlot(int index);
+  void releaseSlotLocked(Slot& slot);
+
+  Slot _slots[PREFETCH_MAX_DEPTH];
+  int _depth = 0;
+  PrefetchStats _stats;
+  SemaphoreHandle_t _mutex = nullptr;
+  QueueHandle_t _requests = nullptr;
+  TaskHandle_t _task = nullptr;
+};
+
+extern FramePrefetcher framePrefetch;
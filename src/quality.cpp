@@ -0,0 +1,79 @@
+#include "quality.h"
+
+AdaptiveQuality snapshotQuality;
+
+// Weight of the newest sample in the moving averages
+static const float EWMA_ALPHA = 0.3f;
+// Rough size of a 240 px high cropped snapshot at each step, refined as images arrive
+static const float INITIAL_BYTES[SNAPSHOT_QUALITY_LEVELS] = {30000, 20000, 15000, 11000, 8000};
+
+static float ewma(float average, float sample, bool first) {
+  return first ? sample : average + EWMA_ALPHA * (sample - average);
+}
+
+AdaptiveQuality::AdaptiveQuality() {
+  for (int i = 0; i < SNAPSHOT_QUALITY_LEVELS; i++) _bytesAtLevel[i] = INITIAL_BYTES[i];
+}
+
+String AdaptiveQuality::apply(const String& url) const {
+  if (url.indexOf("/snapshot.jpg") < 0 || url.indexOf("quality=") >= 0) return url;
+  return url + (url.indexOf('?') >= 0 ? "&" : "?") + "quality=" + String(quality());
+}
+
+int AdaptiveQuality::levelOf(int quality) const {
+  for (int i = 0; i < SNAPSHOT_QUALITY_LEVELS; i++) {
+    if (SNAPSHOT_QUALITY[i] == quality) return i;
+  }
+  return -1;
+}
+
+unsigned long AdaptiveQuality::predictMs(int level) const {
+  if (_stats.throughputKBps <= 0) return 0;
+  return (unsigned long)(_stats.ttfbMs + _bytesAtLevel[level] / 1024.0f / _stats.throughputKBps * 1000.0f);
+}
+
+void AdaptiveQuality::record(int requested, size_t bytes, unsigned long ttfbMs, unsigned long bodyMs) {
+  int level = levelOf(requested);
+  bool first = _stats.samples == 0;
+  float kbps = bytes / 1024.0f / (max(bodyMs, 1UL) / 1000.0f);
+  _stats.throughputKBps = ewma(_stats.throughputKBps, kbps, first);
+  _stats.ttfbMs = ewma(_stats.ttfbMs, ttfbMs, first);
+  _stats.samples++;
+  if (level >= 0) _bytesAtLevel[level] = ewma(_bytesAtLevel[level], bytes, false);
+
+  unsigned long predicted = predictMs(_level);
+  _stats.predictedMs = predicted;
+
+  if (predicted > SNAPSHOT_LATENCY_BUDGET_MS) {
+    _healthyStreak = 0;
+    // Skip straight to the best step that fits, or the lowest one
+    int next = _level;
+    while (next < SNAPSHOT_QUALITY_LEVELS - 1 && predictMs(next) > SNAPSHOT_LATENCY_BUDGET_MS) next++;
+    if (next != _level) {
+      _level = next;
+      _stats.stepDowns++;
+      Serial.printf("[QUALITY] Predicted %lu ms over budget, quality %d\n", predicted, quality());
+    }
+  } else if (_level > 0 && predictMs(_level - 1) <= SNAPSHOT_LATENCY_BUDGET_MS) {
+    if (++_healthyStreak >= SNAPSHOT_UPGRADE_STREAK) {
+      _healthyStreak = 0;
+      _level--;
+      _stats.stepUps++;
+      Serial.printf("[QUALITY] Link healthy, quality %d\n", quality());
+    }
+  } else {
+    _healthyStreak = 0;
+  }
+  _stats.quality = quality();
+}
+
+// A timeout or broken body: assume the link is struggling
+void AdaptiveQuality::recordFailure() {
+  _healthyStreak = 0;
+  if (_level < SNAPSHOT_QUALITY_LEVELS - 1) {
+    _level++;
+    _stats.stepDowns++;
+    _stats.quality = quality();
+    Serial.printf("[QUALITY] Download failed, quality %d\n", quality());
+  }
+}
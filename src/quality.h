@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Target time from request to a complete snapshot
+const unsigned long SNAPSHOT_LATENCY_BUDGET_MS = 500;
+// JPEG quality steps offered to Frigate, best first; 70 is Frigate's own default
+const int SNAPSHOT_QUALITY_LEVELS = 5;
+const int SNAPSHOT_QUALITY[SNAPSHOT_QUALITY_LEVELS] = {85, 70, 55, 40, 25};
+const int SNAPSHOT_DEFAULT_LEVEL = 1;
+// Healthy downloads in a row before trying the next better level
+const int SNAPSHOT_UPGRADE_STREAK = 3;
+
+struct QualityStats {
+  int quality = SNAPSHOT_QUALITY[SNAPSHOT_DEFAULT_LEVEL];
+  float throughputKBps = 0;   // smoothed body throughput
+  float ttfbMs = 0;           // smoothed time to first byte
+  unsigned long predictedMs = 0;
+  uint32_t samples = 0;
+  uint32_t stepDowns = 0;
+  uint32_t stepUps = 0;
+};
+
+// ------------------------
+//  Adaptive snapshot quality
+// ------------------------
+// Learns link throughput, TTFB and the typical snapshot size at each quality
+// step, then asks Frigate for the best quality predicted to arrive within the
+// latency budget. Drops a step at once when over budget, climbs back one step
+// at a time after a run of downloads that would also have fit at the better one.
+// Download task only, apart from reading stats().
+class AdaptiveQuality {
+public:
+  AdaptiveQuality();
+
+  // Adds &quality= to Frigate snapshot URLs that do not choose one themselves
+  String apply(const String& url) const;
+  // bodyMs is the time spent reading the body off the socket, nothing else
+  void record(int requested, size_t bytes, unsigned long ttfbMs, unsigned long bodyMs);
+  void recordFailure();
+
+  int quality() const { return SNAPSHOT_QUALITY[_level]; }
+  const QualityStats& stats() const { return _stats; }
+
+private:
+  unsigned long predictMs(int level) const;
+  int levelOf(int quality) const;
+
+  int _level = SNAPSHOT_DEFAULT_LEVEL;
+  int _healthyStreak = 0;
+  float _bytesAtLevel[SNAPSHOT_QUALITY_LEVELS];
+  QualityStats _stats;
+};
+
+extern AdaptiveQuality snapshotQuality;
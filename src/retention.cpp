@@ -0,0 +1,124 @@
+#include "retention.h"
+#include <SD_MMC.h>
+#include <map>
+#include <vector>
+#include "main.h" // For maxImages and the other limits
+#include "eventindex.h"
+#include "imagecache.h"
+#include "prefetch.h"
+
+RetentionStats retentionStats;
+
+static TaskHandle_t retentionTask = nullptr;
+
+// Before NTP sync time() is near 1970 and ages are meaningless
+static bool clockValid(time_t t) {
+  return t > 1600000000;
+}
+
+// ------------------------
+//  Victim selection
+// ------------------------
+// Walks the index oldest first: expired images go, then each camera is cut to
+// its quota, then the oldest survivors until both count and bytes fit.
+static std::vector<EventFile> selectVictims(const std::vector<EventFile>& files) {
+  std::vector<bool> doomed(files.size(), false);
+  time_t now = time(nullptr);
+
+  if (maxAgeHours > 0 && clockValid(now)) {
+    time_t cutoff = now - (time_t)maxAgeHours * 3600;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (clockValid(files[i].mtime) && files[i].mtime < cutoff) doomed[i] = true;
+    }
+  }
+
+  if (maxImagesPerCamera > 0) {
+    std::map<String, int> perCamera;
+    for (size_t i = 0; i < files.size(); i++) {
+      if (!doomed[i] && !files[i].camera.isEmpty()) perCamera[files[i].camera]++;
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+      if (doomed[i] || files[i].camera.isEmpty()) continue;
+      int& remaining = perCamera[files[i].camera];
+      if (remaining > maxImagesPerCamera) {
+        doomed[i] = true;
+        remaining--;
+      }
+    }
+  }
+
+  size_t count = 0;
+  size_t bytes = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (doomed[i]) continue;
+    count++;
+    bytes += files[i].size;
+  }
+  size_t maxBytes = (size_t)maxStorageMB * 1024 * 1024;
+  for (size_t i = 0; i < files.size(); i++) {
+    bool overCount = count > (size_t)maxImages;
+    bool overBytes = maxBytes > 0 && bytes > maxBytes;
+    if (!overCount && !overBytes) break;
+    if (doomed[i]) continue;
+    doomed[i] = true;
+    count--;
+    bytes -= files[i].size;
+  }
+
+  std::vector<EventFile> victims;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (doomed[i]) victims.push_back(files[i]);
+  }
+  return victims;
+}
+
+// ------------------------
+//  Janitor task
+// ------------------------
+static void sweep() {
+  unsigned long start = millis();
+  std::vector<EventFile> victims = selectVictims(eventIndex.snapshot());
+
+  size_t freed = 0;
+  for (const EventFile& victim : victims) {
+    SD_MMC.remove(victim.name);
+    eventIndex.remove(victim.name);
+    imageCache.remove(victim.name);
+    framePrefetch.invalidate(victim.name);
+    freed += victim.size;
+    vTaskDelay(1); // let the SD bus and other tasks breathe between deletes
+  }
+
+  retentionStats.sweeps++;
+  retentionStats.deleted += victims.size();
+  retentionStats.deletedBytes += freed;
+  retentionStats.lastDeleted = victims.size();
+  retentionStats.lastSweepMs = millis() - start;
+  retentionStats.lastSweepAt = millis();
+  if (!victims.empty()) {
+    Serial.printf("[RETENTION] Removed %u images (%u KB) in %lu ms\n",
+                  (unsigned)victims.size(), (unsigned)(freed / 1024), retentionStats.lastSweepMs);
+  }
+}
+
+static void retentionTaskMain(void* arg) {
+  while (true) {
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RETENTION_SWEEP_INTERVAL)) > 0) {
+      // Let the rest of a burst land, then clear the notifications it caused
+      vTaskDelay(pdMS_TO_TICKS(RETENTION_SETTLE_MS));
+      ulTaskNotifyTake(pdTRUE, 0);
+    }
+    sweep();
+  }
+}
+
+void startRetentionTask() {
+  if (retentionTask) return;
+  xTaskCreatePinnedToCore(retentionTaskMain, "retention", RETENTION_TASK_STACK, nullptr,
+                          RETENTION_TASK_PRIORITY, &retentionTask, RETENTION_TASK_CORE);
+  requestRetentionSweep(); // apply limits to what is already on the card
+}
+
+void requestRetentionSweep() {
+  if (retentionTask) xTaskNotifyGive(retentionTask);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Janitor runs below every other task and never on the download path
+const int RETENTION_TASK_CORE = 0;
+const uint32_t RETENTION_TASK_STACK = 4096;
+const UBaseType_t RETENTION_TASK_PRIORITY = tskIDLE_PRIORITY;
+// A sweep waits this long after being requested so a burst of events is handled in one batch
+const unsigned long RETENTION_SETTLE_MS = 2000;
+// Age limits are also enforced without new events
+const unsigned long RETENTION_SWEEP_INTERVAL = 10UL * 60UL * 1000UL;
+
+struct RetentionStats {
+  uint32_t sweeps = 0;
+  uint32_t deleted = 0;
+  size_t deletedBytes = 0;
+  uint32_t lastDeleted = 0;
+  unsigned long lastSweepMs = 0;
+  unsigned long lastSweepAt = 0;
+};
+
+extern RetentionStats retentionStats;
+
+// Limits live in main.cpp next to maxImages: maxStorageMB, maxAgeHours, maxImagesPerCamera (0 = no limit)
+void startRetentionTask();
+// Non-blocking; coalesces with any sweep already pending
+void requestRetentionSweep();
@@ -0,0 +1,78 @@
+#include "retry.h"
+
+unsigned long backoffDelay(int attempt, unsigned long baseMs, unsigned long maxMs) {
+  unsigned long delayMs = baseMs;
+  for (int i = 0; i < attempt && delayMs < maxMs; i++) delayMs *= 2;
+  if (delayMs > maxMs) delayMs = maxMs;
+  unsigned long half = delayMs / 2;
+  return half + esp_random() % (delayMs - half + 1);
+}
+
+// ------------------------
+//  Circuit breaker
+// ------------------------
+void CircuitBreaker::open() {
+  unsigned long now = millis();
+  if (_state == BREAKER_CLOSED) {
+    _stats.trips++;
+    _stats.openedAt = now;
+    _probeAttempt = 0;
+  }
+  _stats.probeDelayMs = backoffDelay(_probeAttempt++, _probeMinMs, _probeMaxMs);
+  _nextProbeAt = now + _stats.probeDelayMs;
+  _state = BREAKER_OPEN;
+}
+
+// While half-open _nextProbeAt is the deadline for the probe's outcome: a
+// probe whose result never got reported is replaced rather than waited on
+bool CircuitBreaker::probeDue() const {
+  return _state != BREAKER_CLOSED && (long)(millis() - _nextProbeAt) >= 0;
+}
+
+unsigned long CircuitBreaker::probeWait() const {
+  if (_state == BREAKER_CLOSED) return 0;
+  long wait = (long)(_nextProbeAt - millis());
+  return wait > 0 ? wait : 0;
+}
+
+void CircuitBreaker::beginProbe() {
+  _state = BREAKER_HALF_OPEN;
+  _nextProbeAt = millis() + _probeMaxMs;
+  _stats.probes++;
+}
+
+void CircuitBreaker::deferProbe() {
+  if (_state != BREAKER_CLOSED) open();
+}
+
+void CircuitBreaker::recordSuccess() {
+  if (_state != BREAKER_CLOSED) {
+    _stats.lastOutageMs = millis() - _stats.openedAt;
+    Serial.printf("[FRIGATE] Reachable again after %lu s\n", _stats.lastOutageMs / 1000);
+  }
+  _state = BREAKER_CLOSED;
+  _stats.consecutiveFailures = 0;
+  _stats.openedAt = 0;
+}
+
+void CircuitBreaker::recordFailure() {
+  _stats.failures++;
+  _stats.consecutiveFailures++;
+  if (_state == BREAKER_HALF_OPEN) {
+    open();
+    Serial.printf("[FRIGATE] Probe failed, next in %lu s\n", _stats.probeDelayMs / 1000);
+  } else if (_state == BREAKER_CLOSED && _stats.consecutiveFailures >= (uint32_t)_threshold) {
+    open();
+    Serial.printf("[FRIGATE] Unreachable after %u failures, probing in %lu s\n",
+                  (unsigned)_stats.consecutiveFailures, _stats.probeDelayMs / 1000);
+  }
+}
+
+const char* breakerStateToString(BreakerState state) {
+  switch (state) {
+    case BREAKER_CLOSED: return "closed";
+    case BREAKER_OPEN: return "open";
+    case BREAKER_HALF_OPEN: return "half-open";
+  }
+  return "unknown";
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Exponential backoff with jitter: a random delay in [d/2, d] where
+// d = baseMs * 2^attempt, capped at maxMs. Spreads retries from many events
+// instead of having them hit the server in lockstep.
+unsigned long backoffDelay(int attempt, unsigned long baseMs, unsigned long maxMs);
+
+enum BreakerState {
+  BREAKER_CLOSED,     // requests flow
+  BREAKER_OPEN,       // server considered down, only probes go out
+  BREAKER_HALF_OPEN   // a probe is in flight
+};
+
+struct BreakerStats {
+  uint32_t consecutiveFailures = 0;
+  uint32_t failures = 0;
+  uint32_t trips = 0;
+  uint32_t probes = 0;
+  unsigned long openedAt = 0;     // 0 while closed
+  unsigned long lastOutageMs = 0;
+  unsigned long probeDelayMs = 0;
+};
+
+// ------------------------
+//  Circuit breaker
+// ------------------------
+// Trips after `threshold` consecutive failures. While open, probeDue() turns
+// true on a backoff schedule; the caller sends one cheap request and reports
+// it like any other, which closes the breaker or reopens it for longer. A probe
+// whose outcome is never reported makes probeDue() true again after probeMaxMs.
+// Written by one task; state() and stats() may be read from others.
+class CircuitBreaker {
+public:
+  CircuitBreaker(int threshold, unsigned long probeMinMs, unsigned long probeMaxMs)
+    : _threshold(threshold), _probeMinMs(probeMinMs), _probeMaxMs(probeMaxMs) {}
+
+  bool isOpen() const { return _state != BREAKER_CLOSED; }
+  bool probeDue() const;
+  // Milliseconds until the next probe, 0 when one is due or the breaker is closed
+  unsigned long probeWait() const;
+  // Call once the probe request is actually being sent
+  void beginProbe();
+  // A due probe that could not be sent, e.g. WiFi down: wait another backoff step
+  void deferProbe();
+
+  void recordSuccess();
+  void recordFailure();
+
+  BreakerState state() const { return _state; }
+  const BreakerStats& stats() const { return _stats; }
+
+private:
+  void open();
+
+  int _threshold;
+  unsigned long _probeMinMs;
+  unsigned long _probeMaxMs;
+  int _probeAttempt = 0;
+  unsigned long _nextProbeAt = 0;
+  volatile BreakerState _state = BREAKER_CLOSED;
+  BreakerStats _stats;
+};
+
+const char* breakerStateToString(BreakerState state);
@@ -0,0 +1,19 @@
+#include "reviewfilter.h"
+
+const JsonDocument& reviewFilter() {
+  static JsonDocument filter;
+  if (filter.isNull()) {
+    filter["type"] = true;
+    for (const char* side : {"before", "after"}) {
+      filter[side]["id"] = true;
+      filter[side]["camera"] = true;
+      filter[side]["severity"] = true;
+      filter[side]["start_time"] = true;
+      filter[side]["end_time"] = true;
+      filter[side]["data"]["detections"] = true;
+      filter[side]["data"]["zones"] = true;
+      filter[side]["data"]["objects"] = true;
+    }
+  }
+  return filter;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ArduinoJson filter for frigate/reviews: keeps the fields handleReviewMessage()
+// reads, so the rest of a review (thumb_path, sub_labels, audio...) is skipped
+// by the parser without allocating. Built on first use; MQTT task only.
+const JsonDocument& reviewFilter();
@@ -0,0 +1,127 @@
+#include "reviews.h"
+
+ReviewTracker reviewTracker;
+
+int ActiveReview::merge(JsonArray ids) {
+  int added = 0;
+  for (JsonVariant d : ids) {
+    const char* detection = d.as<const char*>();
+    if (!detection || !*detection) continue;
+    bool seen = false;
+    for (const ReviewDetection& known : detections) {
+      if (known.id == detection) {
+        seen = true;
+        break;
+      }
+    }
+    if (seen) continue;
+    if (detections.size() >= (size_t)REVIEW_MAX_DETECTIONS) {
+      Serial.println("[REVIEW] Detection limit reached for " + id);
+      break;
+    }
+    ReviewDetection entry;
+    entry.id = detection;
+    detections.push_back(entry);
+    added++;
+  }
+  return added;
+}
+
+bool ActiveReview::hasPending() const {
+  for (const ReviewDetection& d : detections) {
+    if (!d.queued) return true;
+  }
+  return false;
+}
+
+// ------------------------
+//  Active review table
+// ------------------------
+ActiveReview* ReviewTracker::find(const String& id) {
+  for (ActiveReview& review : _reviews) {
+    if (review.id == id) return &review;
+  }
+  return nullptr;
+}
+
+ActiveReview& ReviewTracker::add(const String& id) {
+  unsigned long now = millis();
+  // Reviews whose "end" never arrived
+  for (auto it = _reviews.begin(); it != _reviews.end();) {
+    if (now - it->updatedAt > REVIEW_STALE_MS) {
+      it = _reviews.erase(it);
+      _stats.evicted++;
+    } else {
+      ++it;
+    }
+  }
+  if (_reviews.size() >= (size_t)REVIEW_TABLE_SIZE) {
+    auto oldest = _reviews.begin();
+    for (auto it = _reviews.begin(); it != _reviews.end(); ++it) {
+      if (now - it->updatedAt > now - oldest->updatedAt) oldest = it;
+    }
+    Serial.println("[REVIEW] Table full, forgetting " + oldest->id);
+    _reviews.erase(oldest);
+    _stats.evicted++;
+  }
+
+  ActiveReview review;
+  review.id = id;
+  _reviews.push_back(review);
+  _stats.started++;
+  return _reviews.back();
+}
+
+ActiveReview& ReviewTracker::observe(const String& id, const String& severity, JsonArray detections) {
+  _stats.messages++;
+  ActiveReview* review = find(id);
+  if (!review) {
+    review = &add(id);
+    review->severity = severity;
+  } else if (review->severity != severity) {
+    Serial.println("[REVIEW] " + id + " severity " + review->severity + " -> " + severity);
+    review->severity = severity;
+    _stats.severityChanges++;
+  }
+  review->updatedAt = millis();
+  review->merge(detections);
+  _stats.active = _reviews.size();
+  return *review;
+}
+
+void ReviewTracker::end(const String& id) {
+  for (auto it = _reviews.begin(); it != _reviews.end(); ++it) {
+    if (it->id == id) {
+      Serial.printf("[REVIEW] %s ended with %u detections\n", id.c_str(), (unsigned)it->detections.size());
+      _reviews.erase(it);
+      _stats.ended++;
+      break;
+    }
+  }
+  _stats.active = _reviews.size();
+}
+
+ActiveReview* ReviewTracker::findExpiredWait(unsigned long maxWait, ReviewDetection*& detection) {
+  unsigned long now = millis();
+  for (ActiveReview& review : _reviews) {
+    for (ReviewDetection& d : review.detections) {
+      if (d.waiting && !d.queued && now - d.waitingSince >= maxWait) {
+        detection = &d;
+        return &review;
+      }
+    }
+  }
+  return nullptr;
+}
+
+ActiveReview* ReviewTracker::findWaiting(const String& detectionId, ReviewDetection*& detection) {
+  for (ActiveReview& review : _reviews) {
+    for (ReviewDetection& d : review.detections) {
+      if (d.waiting && !d.queued && d.id == detectionId) {
+        detection = &d;
+        return &review;
+      }
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <vector>
+
+// Reviews followed at once; a long quiet one is dropped first when full
+const int REVIEW_TABLE_SIZE = 8;
+// Detections remembered per review, later ones are ignored
+const int REVIEW_MAX_DETECTIONS = 32;
+// Reviews without an update for this long are assumed ended, e.g. a missed "end"
+const unsigned long REVIEW_STALE_MS = 30UL * 60UL * 1000UL;
+// Minimum time between conditional refreshes of a review's snapshots
+const unsigned long REVIEW_REFRESH_INTERVAL = 20000;
+
+struct ReviewDetection {
+  String id;
+  bool queued = false;    // snapshot handed to the download task
+  bool waiting = false;   // held until frigate/events reports its snapshot
+  unsigned long waitingSince = 0;
+};
+
+struct ActiveReview {
+  String id;
+  String severity;
+  String camera;          // as of the last message, for detections queued later
+  String zone;
+  uint16_t displaySec = 0; // from the filter rule that matched
+  uint8_t rank = 0;        // download rank of its events, see eventRank()
+  std::vector<ReviewDetection> detections;
+  bool announced = false; // a snapshot was queued for immediate display
+  bool historic = false;  // replayed after an outage, too old to announce: gallery only
+  unsigned long updatedAt = 0;
+  unsigned long refreshedAt = 0; // snapshots queued or last re-checked
+
+  // Adds detections not seen before; returns how many were new
+  int merge(JsonArray ids);
+  bool hasPending() const;
+};
+
+struct ReviewStats {
+  uint32_t messages = 0;
+  uint32_t idle = 0;      // updates that caused no work
+  uint32_t started = 0;
+  uint32_t ended = 0;
+  uint32_t evicted = 0;
+  uint32_t severityChanges = 0;
+  uint32_t historic = 0;  // replayed after an outage, fetched for the gallery only
+  size_t active = 0;
+};
+
+// ------------------------
+//  Active review table
+// ------------------------
+// Frigate repeats a review's full state in every "update". The table keeps what
+// has been seen and queued per review ID so only new detections, or a severity
+// that now qualifies for display, produce downloads. MQTT task only; stats()
+// may be read from others.
+class ReviewTracker {
+public:
+  // Finds or adds the review and merges the message into it
+  ActiveReview& observe(const String& id, const String& severity, JsonArray detections);
+  // "end": the review is final and forgotten
+  void end(const String& id);
+  bool contains(const String& id) { return find(id) != nullptr; }
+  // The review holding a detection that waits for its snapshot, or nullptr
+  ActiveReview* findWaiting(const String& detectionId, ReviewDetection*& detection);
+  // A detection that has waited at least maxWait, or nullptr
+  ActiveReview* findExpiredWait(unsigned long maxWait, ReviewDetection*& detection);
+
+  const ReviewStats& stats() const { return _stats; }
+  // Counts a message that changed nothing worth doing
+  void countIdle() { _stats.idle++; }
+  void countHistoric() { _stats.historic++; }
+
+private:
+  ActiveReview* find(const String& id);
+  ActiveReview& add(const String& id);
+
+  std::vector<ActiveReview> _reviews;
+  ReviewStats _stats;
+};
+
+extern ReviewTracker reviewTracker;
@@ -1,11 +1,12 @@
 #include "weather.h"
 #include <Preferences.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <TFT_eSPI.h>
 #include <SD_MMC.h>
 #include <SPIFFS.h>
 #include <TJpg_Decoder.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
 
 String weatherIcon = "";
 String lastDrawnWeatherIcon = "";
@@ -45,19 +46,90 @@ void showWeatherIconJPG(String iconCode) {
   }
 }
 
-bool fetchCoordinates() {
-  Serial.println("[WEATHER] Fetching coordinates from geocoding API");
-  
-  HTTPClient http;
-  String geocodingUrl = "http://api.openweathermap.org/geo/1.0/direct?q=" + weatherCity + "&limit=1&appid=" + weatherApiKey;
-  Serial.print("[WEATHER] Fetching coordinates from: "); Serial.println(geocodingUrl);
-  http.begin(geocodingUrl);
-  int httpCodeGeo = http.GET();
-  
+// ------------------------
+//  Background requests
+// ------------------------
+// The async client has no TLS and the URLs carry the API key, so requests go
+// over HTTPS on a worker task instead. Replies are handed to loop() through a
+// queue, so parsing, SD and preferences writes and drawing stay on the main task.
+enum WeatherRequestKind { WEATHER_GEOCODE, WEATHER_ONECALL };
+
+struct WeatherRequest {
+  WeatherRequestKind kind;
+  String* url;    // owned by the receiver
+};
+
+struct WeatherReply {
+  WeatherRequestKind kind;
+  int status;
+  String* body;   // owned by the receiver
+};
+
+static QueueHandle_t weatherRequests = nullptr;
+static QueueHandle_t weatherReplies = nullptr;
+static TaskHandle_t weatherTask = nullptr;
+static volatile bool weatherBusy = false;
+
+static void weatherTaskMain(void* arg) {
+  WeatherRequest request;
+  while (true) {
+    if (xQueueReceive(weatherRequests, &request, portMAX_DELAY) != pdTRUE) continue;
+
+    // Encrypted like the blocking client this replaced; the certificate is not pinned
+    WiFiClientSecure client;
+    client.setInsecure();
+    HTTPClient http;
+    http.setTimeout(WEATHER_HTTP_TIMEOUT);
+    WeatherReply reply = {request.kind, 0, new String()};
+    if (http.begin(client, *request.url)) {
+      reply.status = http.GET();
+      if (reply.status == 200) *reply.body = http.getString();
+      http.end();
+    } else {
+      reply.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+    delete request.url;
+
+    if (xQueueSend(weatherReplies, &reply, 0) != pdTRUE) {
+      delete reply.body;
+      weatherBusy = false;
+    }
+  }
+}
+
+static bool requestWeather(WeatherRequestKind kind, const String& url) {
+  if (!weatherTask) {
+    weatherRequests = xQueueCreate(1, sizeof(WeatherRequest));
+    xTaskCreatePinnedToCore(weatherTaskMain, "weather", WEATHER_TASK_STACK, nullptr, 1, &weatherTask, WEATHER_TASK_CORE);
+  }
+  // Busy before starting: the reply may be handled before this returns
+  weatherBusy = true;
+  WeatherRequest request = {kind, new String(url)};
+  if (xQueueSend(weatherRequests, &request, 0) != pdTRUE) {
+    Serial.println("[WEATHER] Could not start request");
+    delete request.url;
+    weatherBusy = false;
+    return false;
+  }
+  return true;
+}
+
+// The URLs hold the API key; never log them whole
+static void logRequest(const char* what, const String& url) {
+  int key = url.indexOf("appid=");
+  Serial.printf("[WEATHER] Fetching %s from: %s\n", what, key < 0 ? url.c_str() : (url.substring(0, key) + "appid=***").c_str());
+}
+
+bool requestCoordinates() {
+  String geocodingUrl = "https://api.openweathermap.org/geo/1.0/direct?q=" + weatherCity + "&limit=1&appid=" + weatherApiKey;
+  logRequest("coordinates", geocodingUrl);
+  return requestWeather(WEATHER_GEOCODE, geocodingUrl);
+}
+
+bool applyCoordinates(int httpCodeGeo, const String& geoPayload) {
   bool success = false;
   
   if (httpCodeGeo == 200) {
-    String geoPayload = http.getString();
     JsonDocument geoDoc;
     DeserializationError error = deserializeJson(geoDoc, geoPayload);
     
@@ -82,7 +154,6 @@ bool fetchCoordinates() {
     Serial.print("[WEATHER] Error fetching coordinates, code: "); Serial.println(httpCodeGeo);
   }
   
-  http.end();
   return success;
 }
 
@@ -110,6 +181,85 @@ void storeWeather(const String& payload) {
 
 }
 
+bool requestOneCall() {
+  // Use cached coordinates for One Call API 3.0
+  String oneCallUrl = "https://api.openweathermap.org/data/3.0/onecall?lat=" + String(cachedLat, 6) + 
+                      "&lon=" + String(cachedLon, 6) + "&appid=" + weatherApiKey + "&units=metric&exclude=minutely,hourly,alerts";
+  logRequest("weather from One Call API", oneCallUrl);
+  return requestWeather(WEATHER_ONECALL, oneCallUrl);
+}
+
+bool applyWeather(int httpCodeOneCall, const String& payload) {
+  if (httpCodeOneCall != 200) {
+    Serial.print("[WEATHER] Error fetching weather data, code: "); Serial.println(httpCodeOneCall);
+    return false;
+  }
+
+  storeWeather(payload);
+
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, payload);
+  if (error) {
+    Serial.print("[WEATHER] JSON parse error: "); Serial.println(error.c_str());
+    return false;
+  }
+
+  // Determine current day as string
+  time_t now = time(nullptr);
+  struct tm *tm_now = localtime(&now);
+  char dateStr[11];
+  strftime(dateStr, sizeof(dateStr), "%Y-%m-%d", tm_now);
+  String todayStr(dateStr);
+  Serial.print("[WEATHER] Current date (todayStr): "); Serial.println(todayStr);
+
+  // Current weather data
+  weatherTemp = doc["current"]["temp"] | 0.0;
+  weatherHumidity = doc["current"]["humidity"] | 0.0;
+  weatherIcon = doc["current"]["weather"][0]["icon"].as<String>();
+
+  Serial.print("[WEATHER] Current temperature: "); Serial.println(weatherTemp);
+  Serial.print("[WEATHER] Current humidity: "); Serial.println(weatherHumidity);
+  Serial.print("[WEATHER] Icon: "); Serial.println(weatherIcon);
+
+  preferences.begin("config", false);
+  // Only update min/max on a new day
+  if (todayStr != weatherTempDay) {
+    // Get today's min/max from daily forecast (first entry is today)
+    if (doc["daily"].size() > 0) {
+      JsonObject today = doc["daily"][0];
+      weatherTempMin = today["temp"]["min"] | 0.0;
+      weatherTempMax = today["temp"]["max"] | 0.0;
+      weatherRainMM = today["rain"] | 0.0; // Rain in mm, if available
+      weatherSnowMM = today["snow"] | 0.0; // Snow in mm, if available
+
+      Serial.print("[WEATHER] Minimum temperature today: "); Serial.println(weatherTempMin);
+      Serial.print("[WEATHER] Maximum temperature today: "); Serial.println(weatherTempMax);
+      Serial.print("[WEATHER] Rain today: "); Serial.println(weatherRainMM);
+      Serial.print("[WEATHER] Snow today: "); Serial.println(weatherSnowMM);
+
+      // Set the day and save all values
+      weatherTempDay = todayStr;
+      preferences.putString("day", weatherTempDay);
+      preferences.putFloat("min", weatherTempMin);
+      preferences.putFloat("max", weatherTempMax);
+      preferences.putFloat("rain", weatherRainMM);
+      preferences.putFloat("snow", weatherSnowMM);
+    } else {
+      Serial.println("[WEATHER] No daily forecast data available");
+      weatherTempMin = 0;
+      weatherTempMax = 0;
+      weatherRainMM = 0;
+      weatherSnowMM = 0;
+    }
+  } else {
+    Serial.println("[WEATHER] Min/max already fetched for this day, no update needed.");
+  }
+  
+  preferences.putFloat("humidity", weatherHumidity);
+  preferences.end();
+  return true;
+}
+
 void fetchWeather() {
   Serial.println("[WEATHER] fetchWeather() started");
 
@@ -118,6 +268,12 @@ void fetchWeather() {
     return;
   }
 
+  if (!weatherReplies) weatherReplies = xQueueCreate(2, sizeof(WeatherReply));
+  if (weatherBusy) {
+    Serial.println("[WEATHER] Request already in flight");
+    return;
+  }
+
   // Check if we need to fetch coordinates
   bool needsCoordinates = false;
 
@@ -132,88 +288,27 @@ void fetchWeather() {
   }
   
   if (needsCoordinates) {
-    if (!fetchCoordinates()) {
-      Serial.println("[WEATHER] Failed to fetch coordinates, aborting weather fetch");
-      return;
-    }
+    requestCoordinates();
+  } else {
+    requestOneCall();
   }
+}
 
-  // Determine current day as string
-  time_t now = time(nullptr);
-  struct tm *tm_now = localtime(&now);
-  char dateStr[11];
-  strftime(dateStr, sizeof(dateStr), "%Y-%m-%d", tm_now);
-  String todayStr(dateStr);
-  Serial.print("[WEATHER] Current date (todayStr): "); Serial.println(todayStr);
+bool handleWeather() {
+  WeatherReply reply;
+  if (!weatherReplies || xQueueReceive(weatherReplies, &reply, 0) != pdTRUE) return false;
 
-  // Use cached coordinates for One Call API 3.0
-  String oneCallUrl = "https://api.openweathermap.org/data/3.0/onecall?lat=" + String(cachedLat, 6) + 
-                      "&lon=" + String(cachedLon, 6) + "&appid=" + weatherApiKey + "&units=metric&exclude=minutely,hourly,alerts";
-  Serial.print("[WEATHER] Fetching weather from One Call API: "); Serial.println(oneCallUrl);
-  
-  HTTPClient http;
-
-  http.begin(oneCallUrl);
-  int httpCodeOneCall = http.GET();
-
-  if (httpCodeOneCall == 200) {
-    String payload = http.getString();
-    http.end();
-
-    storeWeather(payload);
-
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, payload);
-
-    if (!error) {
-      // Current weather data
-      weatherTemp = doc["current"]["temp"] | 0.0;
-      weatherHumidity = doc["current"]["humidity"] | 0.0;
-      weatherIcon = doc["current"]["weather"][0]["icon"].as<String>();
-
-      Serial.print("[WEATHER] Current temperature: "); Serial.println(weatherTemp);
-      Serial.print("[WEATHER] Current humidity: "); Serial.println(weatherHumidity);
-      Serial.print("[WEATHER] Icon: "); Serial.println(weatherIcon);
-
-      // Only update min/max on a new day
-      if (todayStr != weatherTempDay) {
-        // Get today's min/max from daily forecast (first entry is today)
-        if (doc["daily"].size() > 0) {
-          JsonObject today = doc["daily"][0];
-          weatherTempMin = today["temp"]["min"] | 0.0;
-          weatherTempMax = today["temp"]["max"] | 0.0;
-          weatherRainMM = today["rain"] | 0.0; // Rain in mm, if available
-          weatherSnowMM = today["snow"] | 0.0; // Snow in mm, if available
-
-          Serial.print("[WEATHER] Minimum temperature today: "); Serial.println(weatherTempMin);
-          Serial.print("[WEATHER] Maximum temperature today: "); Serial.println(weatherTempMax);
-          Serial.print("[WEATHER] Rain today: "); Serial.println(weatherRainMM);
-          Serial.print("[WEATHER] Snow today: "); Serial.println(weatherSnowMM);
-
-          // Set the day and save all values
-          weatherTempDay = todayStr;
-          preferences.putString("day", weatherTempDay);
-          preferences.putFloat("min", weatherTempMin);
-          preferences.putFloat("max", weatherTempMax);
-          preferences.putFloat("rain", weatherRainMM);
-          preferences.putFloat("snow", weatherSnowMM);
-        } else {
-          Serial.println("[WEATHER] No daily forecast data available");
-          weatherTempMin = 0;
-          weatherTempMax = 0;
-          weatherRainMM = 0;
-          weatherSnowMM = 0;
-        }
-      } else {
-        Serial.println("[WEATHER] Min/max already fetched for this day, no update needed.");
-      }
-      
-      preferences.putFloat("humidity", weatherHumidity);
-    } else {
-      Serial.print("[WEATHER] JSON parse error: "); Serial.println(error.c_str());
+  bool updated = false;
+  if (reply.kind == WEATHER_GEOCODE) {
+    // Chain straight on to the forecast; the request stays busy until it lands
+    if (!applyCoordinates(reply.status, *reply.body) || !requestOneCall()) {
+      Serial.println("[WEATHER] Failed to fetch coordinates, aborting weather fetch");
+      weatherBusy = false;
     }
   } else {
-    Serial.print("[WEATHER] Error fetching weather data, code: "); Serial.println(httpCodeOneCall);
+    updated = applyWeather(reply.status, *reply.body);
+    weatherBusy = false;
   }
-
-}
\ No newline at end of file
+  delete reply.body;
+  return updated;
+}
@@ -1,6 +1,11 @@
 #pragma once
 #include <Arduino.h>
 
+// The HTTPS requests carry the API key; they block, so they run on their own task
+const int WEATHER_TASK_CORE = 0;
+const uint32_t WEATHER_TASK_STACK = 8192;
+const unsigned long WEATHER_HTTP_TIMEOUT = 10000;
+
 extern String weatherApiKey;
 extern String weatherCity;
 
@@ -14,5 +19,8 @@ extern float weatherTempMax;
 extern float weatherRainMM;
 extern float weatherSnowMM;
 
+// Starts a refresh in the background; handleWeather() applies the result
 void fetchWeather();
+// Call from loop(). Returns true when new weather values were applied.
+bool handleWeather();
 void showWeatherIconJPG(String iconCode);
@@ -0,0 +1,149 @@
+#pragma once
+
+// ------------------------
+//  Host stand-in for Arduino.h
+// ------------------------
+// Just enough of the Arduino core and FreeRTOS for the plain-logic modules in
+// src/ to build under [env:native]: a std::string backed String, Serial on
+// stdout, millis()/micros() from the steady clock and no-op mutexes (the
+// tests are single threaded).
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using std::max;
+using std::min;
+
+template <typename T, typename L, typename H>
+inline T constrain(T value, L low, H high) {
+  return value < (T)low ? (T)low : (value > (T)high ? (T)high : value);
+}
+
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+inline unsigned long millis() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now() - start).count();
+}
+
+inline unsigned long micros() {
+  using namespace std::chrono;
+  static const steady_clock::time_point start = steady_clock::now();
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now() - start).count();
+}
+
+class String {
+public:
+  String() {}
+  String(const char* s) : _s(s ? s : "") {}
+  String(const std::string& s) : _s(s) {}
+  String(char c) : _s(1, c) {}
+  explicit String(int v) : _s(std::to_string(v)) {}
+  explicit String(unsigned int v) : _s(std::to_string(v)) {}
+  explicit String(long v) : _s(std::to_string(v)) {}
+  explicit String(unsigned long v) : _s(std::to_string(v)) {}
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return _s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+  char operator[](unsigned int i) const { return i < _s.length() ? _s[i] : 0; }
+
+  int indexOf(char c, unsigned int from = 0) const { return found(_s.find(c, from)); }
+  int indexOf(const char* s, unsigned int from = 0) const { return found(_s.find(s, from)); }
+  int indexOf(const String& s, unsigned int from = 0) const { return found(_s.find(s._s, from)); }
+  String substring(unsigned int from) const { return from < _s.length() ? String(_s.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (to > _s.length()) to = _s.length();
+    return from < to ? String(_s.substr(from, to - from)) : String();
+  }
+  bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.length(), prefix._s) == 0; }
+  bool endsWith(const String& suffix) const {
+    return _s.length() >= suffix._s.length() && _s.compare(_s.length() - suffix._s.length(), suffix._s.length(), suffix._s) == 0;
+  }
+  bool equalsIgnoreCase(const String& other) const {
+    if (_s.length() != other._s.length()) return false;
+    for (size_t i = 0; i < _s.length(); i++) {
+      if (tolower((unsigned char)_s[i]) != tolower((unsigned char)other._s[i])) return false;
+    }
+    return true;
+  }
+  long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+
+  void trim() {
+    size_t begin = 0, end = _s.length();
+    while (begin < end && isspace((unsigned char)_s[begin])) begin++;
+    while (end > begin && isspace((unsigned char)_s[end - 1])) end--;
+    _s = _s.substr(begin, end - begin);
+  }
+  void replace(char from, char to) { std::replace(_s.begin(), _s.end(), from, to); }
+  void toLowerCase() {
+    for (char& c : _s) c = tolower((unsigned char)c);
+  }
+
+  String& operator+=(const String& s) { _s += s._s; return *this; }
+  String& operator+=(const char* s) { _s += s; return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  bool operator==(const String& s) const { return _s == s._s; }
+  bool operator==(const char* s) const { return _s == s; }
+  bool operator!=(const String& s) const { return _s != s._s; }
+  bool operator!=(const char* s) const { return _s != s; }
+  bool operator<(const String& s) const { return _s < s._s; }
+  friend String operator+(String a, const String& b) { return a += b; }
+  friend String operator+(String a, const char* b) { return a += b; }
+  friend String operator+(const char* a, const String& b) { return String(a) += b; }
+
+private:
+  static int found(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+  std::string _s;
+};
+
+class HostSerial {
+public:
+  void print(const String& s) { fputs(s.c_str(), stdout); }
+  void print(const char* s) { fputs(s, stdout); }
+  void println(const String& s = "") { puts(s.c_str()); }
+  void println(const char* s) { puts(s); }
+  int printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+  }
+};
+
+inline HostSerial Serial;
+
+// ------------------------
+//  FreeRTOS
+// ------------------------
+typedef uint32_t TickType_t;
+typedef void* SemaphoreHandle_t;
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  static int token;
+  return &token;
+}
+inline int xSemaphoreTake(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline int xSemaphoreGive(SemaphoreHandle_t) { return pdTRUE; }
@@ -0,0 +1,265 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+#include "filterrules.h"
+
+static FilterRules rules;
+
+// msg is a review's "after" object, e.g. {"severity":"alert","camera":"front_door",...}
+static FilterDecision matchReview(const char* msg) {
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, msg);
+  TEST_ASSERT_FALSE(error);
+  return rules.match(doc.as<JsonObject>());
+}
+
+static bool mayShow(const char* msg) {
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, msg);
+  TEST_ASSERT_FALSE(error);
+  return rules.mayShow(doc["camera"] | "", doc["data"]["objects"].as<JsonArray>(), doc["data"]["zones"].as<JsonArray>());
+}
+
+static const char FRONT_PERSON_ALERT[] =
+    R"({"severity":"alert","camera":"front_door","data":{"objects":["person"],"zones":["driveway"]}})";
+static const char FRONT_PERSON_DETECTION[] =
+    R"({"severity":"detection","camera":"front_door","data":{"objects":["person"],"zones":["driveway"]}})";
+static const char BACK_CAT_DETECTION[] =
+    R"({"severity":"detection","camera":"back_yard","data":{"objects":["cat"],"zones":["lawn"]}})";
+static const char BACK_CAR_ALERT_NO_ZONE[] =
+    R"({"severity":"alert","camera":"back_yard","data":{"objects":["car"],"zones":[]}})";
+
+void setUp() { rules = FilterRules(); }
+void tearDown() {}
+
+void test_nothing_shown_before_compile() {
+  TEST_ASSERT_FALSE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_EQUAL_INT(-1, matchReview(FRONT_PERSON_ALERT).rule);
+}
+
+void test_empty_rule_set_shows_nothing() {
+  TEST_ASSERT_EQUAL_INT(0, rules.compile(""));
+  FilterDecision d = matchReview(FRONT_PERSON_ALERT);
+  TEST_ASSERT_FALSE(d.show);
+  TEST_ASSERT_EQUAL_INT(-1, d.rule);
+}
+
+void test_severity_rule() {
+  rules.compile("show severity=alert");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_TRUE(matchReview(BACK_CAR_ALERT_NO_ZONE).show);
+  TEST_ASSERT_FALSE(matchReview(FRONT_PERSON_DETECTION).show);
+}
+
+void test_camera_rule() {
+  rules.compile("show camera=front_door");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(BACK_CAT_DETECTION).show);
+}
+
+void test_label_rule_any_of_the_objects() {
+  rules.compile("show label=car");
+  TEST_ASSERT_TRUE(matchReview(BACK_CAR_ALERT_NO_ZONE).show);
+  TEST_ASSERT_TRUE(matchReview(R"({"severity":"alert","camera":"x","data":{"objects":["person","car"]}})").show);
+  TEST_ASSERT_FALSE(matchReview(FRONT_PERSON_ALERT).show);
+}
+
+void test_zone_rule() {
+  rules.compile("show zone=driveway");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(BACK_CAT_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(BACK_CAR_ALERT_NO_ZONE).show);
+}
+
+void test_all_fields_must_match() {
+  rules.compile("show severity=detection camera=front_door label=person zone=driveway");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"detection","camera":"front_door","data":{"objects":["person"],"zones":["porch"]}})").show);
+}
+
+void test_list_matches_either() {
+  rules.compile("show camera=front_door,back_yard label=person,cat");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_DETECTION).show);
+  TEST_ASSERT_TRUE(matchReview(BACK_CAT_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(BACK_CAR_ALERT_NO_ZONE).show);
+}
+
+void test_omitted_field_matches_missing_values() {
+  rules.compile("show severity=alert");
+  TEST_ASSERT_TRUE(matchReview(R"({"severity":"alert"})").show);
+  TEST_ASSERT_TRUE(matchReview(R"({"severity":"alert","camera":"","data":{"objects":[],"zones":[]}})").show);
+}
+
+void test_named_field_rejects_missing_values() {
+  rules.compile("show label=person\nshow zone=driveway");
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"alert","camera":"front_door"})").show);
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"alert","camera":"front_door","data":{"objects":[],"zones":[]}})").show);
+}
+
+void test_unknown_names_do_not_match_named_rules() {
+  rules.compile("show camera=front_door");
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"alert","camera":"garage"})").show);
+}
+
+void test_case_insensitive() {
+  rules.compile("show camera=Front_Door label=PERSON");
+  TEST_ASSERT_TRUE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_TRUE(matchReview(R"({"camera":"FRONT_DOOR","data":{"objects":["Person"]}})").show);
+}
+
+void test_hash_collision_is_not_a_match() {
+  // "costarring" and "liquid" share a 32-bit FNV-1a hash
+  rules.compile("show camera=costarring");
+  TEST_ASSERT_TRUE(matchReview(R"({"severity":"alert","camera":"Costarring"})").show);
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"alert","camera":"liquid"})").show);
+
+  rules.compile("ignore camera=costarring\nshow camera=liquid");
+  TEST_ASSERT_EQUAL_INT(1, matchReview(R"({"severity":"alert","camera":"liquid"})").rule);
+}
+
+void test_label_suffix_stripped() {
+  rules.compile("show label=person");
+  TEST_ASSERT_TRUE(matchReview(R"({"severity":"alert","camera":"x","data":{"objects":["person-verified"]}})").show);
+  TEST_ASSERT_FALSE(matchReview(R"({"severity":"alert","camera":"x","data":{"objects":["-person"]}})").show);
+}
+
+void test_first_match_wins() {
+  rules.compile("ignore label=cat\nshow\nshow label=cat duration=99");
+  FilterDecision cat = matchReview(BACK_CAT_DETECTION);
+  TEST_ASSERT_FALSE(cat.show);
+  TEST_ASSERT_EQUAL_INT(0, cat.rule);
+  FilterDecision person = matchReview(FRONT_PERSON_DETECTION);
+  TEST_ASSERT_TRUE(person.show);
+  TEST_ASSERT_EQUAL_INT(1, person.rule);
+}
+
+void test_show_before_ignore() {
+  rules.compile("show camera=back_yard\nignore label=cat\nshow");
+  TEST_ASSERT_TRUE(matchReview(BACK_CAT_DETECTION).show);
+  TEST_ASSERT_FALSE(matchReview(R"({"camera":"front_door","data":{"objects":["cat"]}})").show);
+}
+
+void test_duration_and_priority() {
+  rules.compile("show severity=alert duration=20 priority=3\nshow duration=99999 priority=999");
+  FilterDecision alert = matchReview(FRONT_PERSON_ALERT);
+  TEST_ASSERT_EQUAL_UINT32(20, alert.durationSec);
+  TEST_ASSERT_EQUAL_UINT32(3, alert.priority);
+  FilterDecision clamped = matchReview(FRONT_PERSON_DETECTION);
+  TEST_ASSERT_EQUAL_UINT32(3600, clamped.durationSec);
+  TEST_ASSERT_EQUAL_UINT32(255, clamped.priority);
+}
+
+void test_bad_lines_skipped() {
+  const char* text =
+      "# comment\n"
+      "\n"
+      "bogus camera=front_door\n"
+      "show colour=red\n"
+      "show camera\n"
+      "show zone=\n"
+      "\tshow label=person  \n";
+  TEST_ASSERT_EQUAL_INT(1, rules.compile(text));
+  FilterDecision d = matchReview(FRONT_PERSON_ALERT);
+  TEST_ASSERT_TRUE(d.show);
+  TEST_ASSERT_EQUAL_INT(0, d.rule);
+  TEST_ASSERT_FALSE(matchReview(BACK_CAT_DETECTION).show);
+}
+
+void test_rule_limit() {
+  String text;
+  for (int i = 0; i < FILTER_MAX_RULES + 4; i++) text += "show severity=alert\n";
+  TEST_ASSERT_EQUAL_INT(FILTER_MAX_RULES, rules.compile(text));
+}
+
+void test_recompile_replaces_rules() {
+  rules.compile("show camera=front_door");
+  rules.compile("show camera=back_yard");
+  TEST_ASSERT_FALSE(matchReview(FRONT_PERSON_ALERT).show);
+  TEST_ASSERT_TRUE(matchReview(BACK_CAT_DETECTION).show);
+}
+
+void test_from_mode() {
+  TEST_ASSERT_EQUAL_STRING("show severity=alert\nshow severity=detection\n", FilterRules::fromMode("Alert,Detection").c_str());
+  TEST_ASSERT_EQUAL_STRING("show severity=alert\n", FilterRules::fromMode("alert").c_str());
+  TEST_ASSERT_EQUAL_STRING("", FilterRules::fromMode("").c_str());
+}
+
+void test_may_show_tries_both_severities() {
+  rules.compile("show severity=detection label=person\nshow severity=alert camera=back_yard\nignore");
+  TEST_ASSERT_TRUE(mayShow(FRONT_PERSON_ALERT));
+  TEST_ASSERT_TRUE(mayShow(BACK_CAT_DETECTION));
+  TEST_ASSERT_FALSE(mayShow(R"({"camera":"front_door","data":{"objects":["cat"]}})"));
+}
+
+void test_may_show_honours_ignore() {
+  rules.compile("ignore label=cat\nshow");
+  TEST_ASSERT_FALSE(mayShow(BACK_CAT_DETECTION));
+  TEST_ASSERT_TRUE(mayShow(FRONT_PERSON_DETECTION));
+}
+
+void test_stats() {
+  rules.compile("ignore label=cat\nshow severity=alert");
+  matchReview(FRONT_PERSON_ALERT);
+  matchReview(BACK_CAT_DETECTION);
+  matchReview(FRONT_PERSON_DETECTION);
+  mayShow(FRONT_PERSON_ALERT);
+  const FilterStats& s = rules.stats();
+  TEST_ASSERT_EQUAL_UINT32(2, s.rules);
+  TEST_ASSERT_EQUAL_UINT32(3, s.evaluated);
+  TEST_ASSERT_EQUAL_UINT32(1, s.shown);
+  TEST_ASSERT_EQUAL_UINT32(1, s.ignored);
+  TEST_ASSERT_EQUAL_UINT32(1, s.unmatched);
+}
+
+void bench_match() {
+  rules.compile(
+      "ignore label=cat,dog,bird\n"
+      "show severity=alert camera=front_door,garage duration=20 priority=3\n"
+      "show severity=detection label=person zone=driveway,porch\n"
+      "ignore camera=back_yard zone=lawn\n"
+      "show severity=alert\n"
+      "show severity=detection label=car,truck,bicycle\n");
+  JsonDocument doc;
+  deserializeJson(doc, R"({"severity":"detection","camera":"back_yard","data":{"objects":["person-verified","car","bicycle"],"zones":["gate","lawn"]}})");
+  JsonObject msg = doc.as<JsonObject>();
+
+  const uint32_t rounds = 1000000;
+  int matched = 0;
+  unsigned long start = micros();
+  for (uint32_t i = 0; i < rounds; i++) matched += rules.match(msg).rule;
+  unsigned long elapsed = micros() - start;
+  TEST_ASSERT_EQUAL_INT(3 * (int)rounds, matched);
+  Serial.printf("[BENCH] filter match, 6 rules: %.1f ns\n", elapsed * 1000.0 / rounds);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_nothing_shown_before_compile);
+  RUN_TEST(test_empty_rule_set_shows_nothing);
+  RUN_TEST(test_severity_rule);
+  RUN_TEST(test_camera_rule);
+  RUN_TEST(test_label_rule_any_of_the_objects);
+  RUN_TEST(test_zone_rule);
+  RUN_TEST(test_all_fields_must_match);
+  RUN_TEST(test_list_matches_either);
+  RUN_TEST(test_omitted_field_matches_missing_values);
+  RUN_TEST(test_named_field_rejects_missing_values);
+  RUN_TEST(test_unknown_names_do_not_match_named_rules);
+  RUN_TEST(test_case_insensitive);
+  RUN_TEST(test_hash_collision_is_not_a_match);
+  RUN_TEST(test_label_suffix_stripped);
+  RUN_TEST(test_first_match_wins);
+  RUN_TEST(test_show_before_ignore);
+  RUN_TEST(test_duration_and_priority);
+  RUN_TEST(test_bad_lines_skipped);
+  RUN_TEST(test_rule_limit);
+  RUN_TEST(test_recompile_replaces_rules);
+  RUN_TEST(test_from_mode);
+  RUN_TEST(test_may_show_tries_both_severities);
+  RUN_TEST(test_may_show_honours_ignore);
+  RUN_TEST(test_stats);
+  RUN_TEST(bench_match);
+  return UNITY_END();
+}
@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "latency.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_empty_histogram() {
+  LatencyHistogram h;
+  TEST_ASSERT_EQUAL_UINT32(0, h.count());
+  TEST_ASSERT_EQUAL_UINT32(0, h.percentile(0.5f));
+}
+
+void test_exact_below_16ms() {
+  LatencyHistogram h;
+  for (unsigned long ms = 0; ms < 16; ms++) h.record(ms);
+  TEST_ASSERT_EQUAL_UINT32(16, h.count());
+  TEST_ASSERT_EQUAL_UINT32(7, h.percentile(0.5f));
+  TEST_ASSERT_EQUAL_UINT32(15, h.percentile(1.0f));
+}
+
+void test_percentile_within_bucket_width() {
+  for (unsigned long ms : {17UL, 100UL, 733UL, 4096UL, 30000UL, 65535UL}) {
+    LatencyHistogram h;
+    h.record(ms);
+    h.record(1);
+    unsigned long p = h.percentile(1.0f);
+    TEST_ASSERT_TRUE(p >= ms);
+    TEST_ASSERT_TRUE(p <= ms + ms / 8);
+  }
+}
+
+void test_percentile_never_above_max() {
+  LatencyHistogram h;
+  h.record(1000);
+  TEST_ASSERT_EQUAL_UINT32(1000, h.percentile(0.99f));
+  TEST_ASSERT_EQUAL_UINT32(1000, h.maxMs());
+}
+
+void test_clamps_beyond_range() {
+  LatencyHistogram h;
+  h.record(200000);
+  TEST_ASSERT_EQUAL_UINT32(1, h.count());
+  TEST_ASSERT_EQUAL_UINT32(200000, h.maxMs());
+  TEST_ASSERT_TRUE(h.percentile(1.0f) >= LATENCY_MAX_MS);
+}
+
+void test_tail_percentiles() {
+  LatencyHistogram h;
+  for (int i = 0; i < 95; i++) h.record(50);
+  for (int i = 0; i < 5; i++) h.record(2000);
+  TEST_ASSERT_TRUE(h.percentile(0.5f) < 60);
+  TEST_ASSERT_TRUE(h.percentile(0.99f) >= 2000);
+}
+
+void bench_record() {
+  LatencyHistogram h;
+  const uint32_t samples = 5000000;
+  unsigned long start = micros();
+  for (uint32_t i = 0; i < samples; i++) h.record((i * 2654435761u) >> 17);
+  unsigned long elapsed = micros() - start;
+  TEST_ASSERT_EQUAL_UINT32(samples, h.count());
+  Serial.printf("[BENCH] histogram record: %.1f ns, p95 %lu ms\n", elapsed * 1000.0 / samples, h.percentile(0.95f));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_histogram);
+  RUN_TEST(test_exact_below_16ms);
+  RUN_TEST(test_percentile_within_bucket_width);
+  RUN_TEST(test_percentile_never_above_max);
+  RUN_TEST(test_clamps_beyond_range);
+  RUN_TEST(test_tail_percentiles);
+  RUN_TEST(bench_record);
+  return UNITY_END();
+}
@@ -0,0 +1,137 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <unity.h>
+#include <new>
+#include "reviewfilter.h"
+
+// ------------------------
+//  frigate/reviews parse benchmark
+// ------------------------
+// Compares the old onMqttMessage() path (payload copied into a String byte by
+// byte, whole review parsed) against handleReviewMessage() (parsed in place
+// through the field filter). Reports heap bytes and microseconds per message
+// for recorded Frigate 0.14 review payloads.
+
+static size_t heapBytes = 0;
+static uint32_t heapAllocs = 0;
+
+void* operator new(size_t size) {
+  heapBytes += size;
+  heapAllocs++;
+  if (void* p = malloc(size)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+class CountingAllocator : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    heapBytes += size;
+    heapAllocs++;
+    return malloc(size);
+  }
+  void deallocate(void* p) override { free(p); }
+  void* reallocate(void* p, size_t size) override {
+    heapBytes += size;
+    heapAllocs++;
+    return realloc(p, size);
+  }
+};
+
+static CountingAllocator countingAllocator;
+
+static const char REVIEW_NEW[] = R"({"type":"new","before":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":null,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx"],"objects":["person"],"sub_labels":[],"zones":["driveway"],"audio":[]}},"after":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":null,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx"],"objects":["person"],"sub_labels":[],"zones":["driveway"],"audio":[]}}})";
+
+static const char REVIEW_UPDATE[] = R"({"type":"update","before":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":null,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx"],"objects":["person"],"sub_labels":[],"zones":["driveway"],"audio":[]}},"after":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":null,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx","1718987131.528174-9dpqzm","1718987133.104592-x7f2la"],"objects":["person","car","person-verified"],"sub_labels":["Alice"],"zones":["driveway","front_steps"],"audio":["speech"]}}})";
+
+static const char REVIEW_END[] = R"({"type":"end","before":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":null,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx","1718987131.528174-9dpqzm","1718987133.104592-x7f2la"],"objects":["person","car","person-verified"],"sub_labels":["Alice"],"zones":["driveway","front_steps"],"audio":["speech"]}},"after":{"id":"1718987129.308396-fqk5ka","camera":"front_cam","start_time":1718987129.308396,"end_time":1718987161.882013,"severity":"alert","thumb_path":"/media/frigate/clips/review/thumb-front_cam-1718987129.308396-fqk5ka.webp","data":{"detections":["1718987128.947436-g92ztx","1718987131.528174-9dpqzm","1718987133.104592-x7f2la"],"objects":["person","car","person-verified"],"sub_labels":["Alice"],"zones":["driveway","front_steps"],"audio":["speech"]}}})";
+
+struct Payload {
+  const char* name;
+  const char* json;
+};
+
+static const Payload PAYLOADS[] = {
+  {"new", REVIEW_NEW},
+  {"update", REVIEW_UPDATE},
+  {"end", REVIEW_END},
+};
+
+// Before: String copy of the payload for logging, then the whole review
+static size_t parseBefore(const uint8_t* payload, size_t len) {
+  String payloadStr;
+  for (size_t i = 0; i < len; i++) payloadStr += (char)payload[i];
+  JsonDocument doc(&countingAllocator);
+  DeserializationError error = deserializeJson(doc, (const char*)payload, len);
+  TEST_ASSERT_FALSE(error);
+  return doc["after"]["data"]["detections"].size() + payloadStr.length();
+}
+
+// After: in place through the filter
+static size_t parseAfter(const uint8_t* payload, size_t len) {
+  JsonDocument doc(&countingAllocator);
+  DeserializationError error = deserializeJson(doc, (const char*)payload, len, DeserializationOption::Filter(reviewFilter()));
+  TEST_ASSERT_FALSE(error);
+  return doc["after"]["data"]["detections"].size();
+}
+
+void setUp() { reviewFilter(); }
+void tearDown() {}
+
+void test_filter_keeps_fields_used_by_the_handler() {
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, REVIEW_UPDATE, strlen(REVIEW_UPDATE), DeserializationOption::Filter(reviewFilter()));
+  TEST_ASSERT_FALSE(error);
+  TEST_ASSERT_EQUAL_STRING("update", doc["type"] | "");
+  JsonObject after = doc["after"];
+  TEST_ASSERT_EQUAL_STRING("1718987129.308396-fqk5ka", after["id"] | "");
+  TEST_ASSERT_EQUAL_STRING("front_cam", after["camera"] | "");
+  TEST_ASSERT_EQUAL_STRING("alert", after["severity"] | "");
+  TEST_ASSERT_EQUAL(3, after["data"]["detections"].size());
+  TEST_ASSERT_EQUAL_STRING("front_steps", after["data"]["zones"][1] | "");
+  TEST_ASSERT_EQUAL_STRING("person-verified", after["data"]["objects"][2] | "");
+  TEST_ASSERT_TRUE(after["start_time"].is<double>());
+  TEST_ASSERT_TRUE(after["end_time"].isNull());
+  TEST_ASSERT_TRUE(after["thumb_path"].isNull());
+  TEST_ASSERT_TRUE(after["data"]["sub_labels"].isNull());
+}
+
+void bench_review_parse() {
+  const int rounds = 20000;
+  for (const Payload& p : PAYLOADS) {
+    const uint8_t* payload = (const uint8_t*)p.json;
+    size_t len = strlen(p.json);
+    size_t sink = 0;
+
+    heapBytes = 0;
+    heapAllocs = 0;
+    sink += parseBefore(payload, len);
+    size_t beforeBytes = heapBytes;
+    uint32_t beforeAllocs = heapAllocs;
+    unsigned long start = micros();
+    for (int i = 0; i < rounds; i++) sink += parseBefore(payload, len);
+    double beforeUs = (double)(micros() - start) / rounds;
+
+    heapBytes = 0;
+    heapAllocs = 0;
+    sink += parseAfter(payload, len);
+    size_t afterBytes = heapBytes;
+    uint32_t afterAllocs = heapAllocs;
+    start = micros();
+    for (int i = 0; i < rounds; i++) sink += parseAfter(payload, len);
+    double afterUs = (double)(micros() - start) / rounds;
+
+    Serial.printf("[BENCH] review %-6s %4u B payload: before %5u B in %3u allocs, %6.2f us | after %5u B in %3u allocs, %6.2f us (%zu)\n",
+                  p.name, (unsigned)len, (unsigned)beforeBytes, beforeAllocs, beforeUs,
+                  (unsigned)afterBytes, afterAllocs, afterUs, sink);
+    TEST_ASSERT_TRUE(afterBytes < beforeBytes);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_filter_keeps_fields_used_by_the_handler);
+  RUN_TEST(bench_review_parse);
+  return UNITY_END();
+}